@@ -23,7 +23,8 @@ class virtual_enable_shared_from_this_base : public std::enable_shared_from_this
 template <class T>
 class virtual_enable_shared_from_this : virtual public virtual_enable_shared_from_this_base {
  public:
-    std::shared_ptr<T> shared_from_this() { return std::dynamic_pointer_cast<T>(virtual_enable_shared_from_this_base::shared_from_this()); }
+    // T derives from this class non-virtually: the downcast is static, the pointer shares the ownership of the base
+    std::shared_ptr<T> shared_from_this() { return std::shared_ptr<T>(virtual_enable_shared_from_this_base::shared_from_this(), static_cast<T*>(this)); }
     /* Utility method to easily downcast.
      * Useful when a child doesn't inherit directly from enable_shared_from_this
      * but wants to use the feature.
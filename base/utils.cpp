@@ -130,7 +130,9 @@ instance_log::instance_log(const char* function_name, void* instance_this, int l
 }
 
 instance_log::~instance_log(void) {
-    auto destruct_function_name(function_name_);
+    if (log_severity_level_ < log_message::reporting_level())
+        return;
+    std::string destruct_function_name(function_name_);
     auto pos = destruct_function_name.find("::");
     if (pos != std::string::npos)
         destruct_function_name = destruct_function_name.replace(pos, 2, "::~");
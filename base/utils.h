@@ -113,9 +113,9 @@ else log_message(__FILE__, __LINE__, severity).stream()
 
 #define FUNCTION_SCOPE_LOG auto STRING_JOIN(scope_guard, __LINE__) = make_function_scope_log(__FUNCTION__, 0)
 
-#define INSTANCE_LOG_DECLARE                           std::unique_ptr<instance_log>  sp_instance_log_
-#define INSTANCE_LOG_IMPL                              sp_instance_log_(std::make_unique<instance_log>(__FUNCTION__, this, 0))
-#define INSTANCE_LOG_EX(severity_inc)                   sp_instance_log_(std::make_unique<instance_log>(__FUNCTION__, this, severity_inc))
+#define INSTANCE_LOG_DECLARE                           instance_log  instance_log_
+#define INSTANCE_LOG_IMPL                              instance_log_(__FUNCTION__, this, 0)
+#define INSTANCE_LOG_EX(severity_inc)                   instance_log_(__FUNCTION__, this, severity_inc)
 
 int& log_reporting_level(void);
 typedef void (*log_handler_type)(uintptr_t user_data, int severity_level, const char* message, uint32_t message_content_offset);
@@ -162,6 +162,7 @@ class log_message {
     unsigned int            message_offset_;
 };
 
+// A member of the logged object: it isn't allocated, and the name is only formatted if the level is reported
 class instance_log {
  public:
     typedef instance_log                        this_type;
@@ -173,7 +174,8 @@ class instance_log {
     this_type& operator=(const this_type&) = delete;
 
  private:
-    std::string     function_name_;
+    // __FUNCTION__, it lives as long as the program
+    const char*     function_name_;
     void*           instance_this_;
     int             log_severity_level_;
 };
@@ -7,11 +7,12 @@ see: https://www.boost.org/doc/libs/1_79_0/libs/beast/doc/html/beast/examples.ht
 """
 
 import ctypes
+import inspect
 import os
 import sys
+import traceback
 import functools
 import platform
-import threading
 
 beast_utils_dll_base_name, beast_utils_dll_version, os_system = ('beast_utils', '1.0.0', platform.system())
 beast_utils_py_path = os.path.dirname(os.path.abspath(__file__))
@@ -92,6 +93,217 @@ def set_server_shutdown_handler(handler) -> None:
     current_function.handler = handler_type(functools.partial(_handler_wrapper, handler))
     beast_utils_dll.set_server_shutdown_handler(current_function.handler, c_uint(0))
 
+ENDPOINT_MODE_PLAIN, ENDPOINT_MODE_TLS, ENDPOINT_MODE_FLEX = (0, 1, 2)
+def add_server_endpoint(address: str, port: int, mode: int = ENDPOINT_MODE_FLEX) -> bool:
+    """add a listening endpoint, it must be called before run_server and the endpoints replace its port
+
+    Args:
+        address: an IPv4 or IPv6 address, e.g. '127.0.0.1', '::' or '0.0.0.0'
+        port: the listening port
+        mode: ENDPOINT_MODE_PLAIN, ENDPOINT_MODE_TLS(requires run_server with ssl) or ENDPOINT_MODE_FLEX(detects TLS)
+
+    Returns:
+        return False if the address or the mode is invalid
+
+    """
+    func = beast_utils_dll.add_server_endpoint
+    func.restype = ctypes.c_bool
+    func.argtypes = [ctypes.c_char_p, ctypes.c_uint16, ctypes.c_int32]
+    return func(address.encode(), port, mode)
+
+def add_unix_endpoint(path: str, permissions: int = 0) -> bool:
+    """add a local(AF_UNIX) endpoint for a reverse proxy on the same host, it must be called before run_server
+
+    Args:
+        path: the socket file, a path beginning with '@' is in the abstract namespace(Linux)
+        permissions: the mode of the socket file, e.g. 0o660, 0 keeps the umask
+
+    Returns:
+        return False if the path is invalid or if the platform has no local sockets
+
+    """
+    func = beast_utils_dll.add_unix_endpoint
+    func.restype = ctypes.c_bool
+    func.argtypes = [ctypes.c_char_p, ctypes.c_uint32]
+    return func(path.encode(), permissions)
+
+def clear_server_endpoints() -> None:
+    """remove the listening endpoints, run_server listens on its port again"""
+    beast_utils_dll.clear_server_endpoints()
+
+def set_socket_options(tcp_nodelay: bool = False, send_buffer: int = 0, receive_buffer: int = 0, busy_poll: int = 0) -> None:
+    """set the socket options of the TCP connections, it must be called before run_server(0 keeps the system default)
+
+    Args:
+        tcp_nodelay: disable Nagle's algorithm
+        send_buffer: SO_SNDBUF(bytes)
+        receive_buffer: SO_RCVBUF(bytes), also set on the acceptors
+        busy_poll: SO_BUSY_POLL(microseconds), above net.core.busy_read it requires CAP_NET_ADMIN
+
+    """
+    func = beast_utils_dll.set_socket_options
+    func.argtypes = [ctypes.c_bool, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_uint32]
+    func(tcp_nodelay, send_buffer, receive_buffer, busy_poll)
+
+def set_listen_socket_options(defer_accept: int = 0, fastopen_queue: int = 0) -> None:
+    """set the socket options of the acceptors, it must be called before run_server(0 keeps the system default)
+
+    Args:
+        defer_accept: TCP_DEFER_ACCEPT(seconds), the connection is accepted when its first data arrives
+        fastopen_queue: TCP_FASTOPEN, the pending requests whose data came with the SYN
+
+    """
+    func = beast_utils_dll.set_listen_socket_options
+    func.argtypes = [ctypes.c_uint32, ctypes.c_uint32]
+    func(defer_accept, fastopen_queue)
+
+def set_tcp_keepalive(idle: int, interval: int = 0, count: int = 0) -> None:
+    """set the keepalive probes of the TCP connections, it must be called before run_server
+
+    Args:
+        idle: the seconds before the first probe, 0 disables the keepalive
+        interval: the seconds between the probes, 0 keeps the system default
+        count: the probes before the connection is dropped, 0 keeps the system default
+
+    """
+    func = beast_utils_dll.set_tcp_keepalive
+    func.argtypes = [ctypes.c_uint32, ctypes.c_uint32, ctypes.c_uint32]
+    func(idle, interval, count)
+
+def set_listen_acceptors(acceptor_count: int) -> None:
+    """set the acceptors of the listening port, it must be called before run_server
+
+    Args:
+        acceptor_count: more than one acceptor(typically the concurrency hint) are bound with SO_REUSEPORT and accept in parallel
+
+    """
+    func = beast_utils_dll.set_listen_acceptors
+    func.argtypes = [ctypes.c_uint32]
+    func(acceptor_count)
+
+ADMISSION_REJECT, ADMISSION_PAUSE = (0, 1)
+def set_admission_limits(max_connections: int, max_connections_per_ip: int = 0, overload_policy: int = ADMISSION_REJECT) -> None:
+    """set the admission control of the connections, it must be called before run_server, 0 means unlimited
+
+    Args:
+        max_connections: the opened connections of the server
+        max_connections_per_ip: the opened connections of a client address, the new ones over the limit get a 503
+        overload_policy: ADMISSION_REJECT(a 503 over max_connections) or ADMISSION_PAUSE(stop accepting until the connections fall to 90%)
+
+    """
+    func = beast_utils_dll.set_admission_limits
+    func.argtypes = [ctypes.c_uint32, ctypes.c_uint32, ctypes.c_int32]
+    func(max_connections, max_connections_per_ip, overload_policy)
+
+def rate_limit_add_rule(prefix: str, rate: float, burst: int) -> bool:
+    """add a rate limit, it must be called before run_server. Over the limit, a request gets a 429 and a ws message is dropped natively
+
+    Args:
+        prefix: the beginning of the route, e.g. '/api/' or '/' for all, the longest matching prefix applies
+        rate: the requests per second of a client
+        burst: the requests of a client at once
+
+    Returns:
+        return False if the prefix is empty, or if the rate or the burst is 0
+
+    """
+    func = beast_utils_dll.rate_limit_add_rule
+    func.restype = ctypes.c_bool
+    func.argtypes = [ctypes.c_char_p, ctypes.c_double, ctypes.c_uint32]
+    return func(prefix.encode(), rate, burst)
+
+def rate_limit_clear_rules() -> None:
+    """remove the rate limits"""
+    beast_utils_dll.rate_limit_clear_rules()
+
+def rate_limit_set_key_header(header: str = None) -> None:
+    """tell the clients of an address apart by the value of a header(e.g. 'X-Api-Key')
+
+    Args:
+        header: the header name, None means the client address only
+
+    """
+    func = beast_utils_dll.rate_limit_set_key_header
+    func.argtypes = [ctypes.c_char_p]
+    func(header.encode() if header else None)
+
+def rate_limit_set_max_buckets(max_buckets: int = 100 * 1000) -> None:
+    """cap the token buckets, a new client is refused with a 429 at the cap, it must be called before run_server
+
+    Args:
+        max_buckets: the max buckets of the active clients, 0 means unlimited
+
+    """
+    func = beast_utils_dll.rate_limit_set_max_buckets
+    func.argtypes = [ctypes.c_uint32]
+    func(max_buckets)
+
+IO_DISTRIBUTION_ROUND_ROBIN, IO_DISTRIBUTION_LEAST_LOADED = (0, 1)
+def set_io_context_per_thread(enable: bool, distribution: int = IO_DISTRIBUTION_ROUND_ROBIN, cpus: list = None) -> None:
+    """run an io_context per io thread, it must be called before run_server
+
+    Args:
+        enable: every io thread runs its own io_context and keeps the connections it got
+        distribution: IO_DISTRIBUTION_ROUND_ROBIN or IO_DISTRIBUTION_LEAST_LOADED(the fewest opened connections)
+        cpus: the thread i is pinned to cpus[i % len(cpus)], None means no pinning
+
+    """
+    cpus = cpus or []
+    func = beast_utils_dll.set_io_context_per_thread
+    func.argtypes = [ctypes.c_bool, ctypes.c_int32, ctypes.POINTER(ctypes.c_int32), ctypes.c_uint32]
+    func(enable, distribution, (ctypes.c_int32 * len(cpus))(*cpus), len(cpus))
+
+def set_low_memory_mode(enable: bool, connection_buffer_max: int = 0) -> None:
+    """release the buffers of the idle connections, it must be called before run_server
+
+    Args:
+        enable: the read buffers are released after each message and OpenSSL releases its buffers while a connection is idle
+        connection_buffer_max: the cap of the read buffer of a connection(an HTTP header, a ws message), 0 means unlimited
+
+    """
+    func = beast_utils_dll.set_low_memory_mode
+    func.argtypes = [ctypes.c_bool, ctypes.c_uint32]
+    func(enable, connection_buffer_max)
+
+def set_session_pool_cache(cache_bytes_per_class: int = 256 * 1024) -> None:
+    """set the bytes kept by each free list (per io thread and per size class) of the session pool, it must be called before run_server
+
+    Args:
+        cache_bytes_per_class: 0 means that the sessions and their buffers always go back to the heap
+
+    """
+    func = beast_utils_dll.set_session_pool_cache
+    func.argtypes = [ctypes.c_uint32]
+    func(cache_bytes_per_class)
+
+def set_handler_arena(enable: bool = True) -> None:
+    """allocate the async operations of a session from a few slots of the session, it must be called before run_server
+
+    Args:
+        enable: False means that the operations are allocated by the session pool
+
+    """
+    func = beast_utils_dll.set_handler_arena
+    func.argtypes = [ctypes.c_bool]
+    func(enable)
+
+SERVER_COUNTER_VISIT_CB = ctypes.CFUNCTYPE(None, c_uint, ctypes.c_char_p, ctypes.c_uint64)
+def get_server_counters() -> dict:
+    """Get the statistics counters of the server
+
+    Returns:
+        return {counter_name: value}
+
+    """
+    counters = {}
+    def _visit_cb(user_data, name: bytes, value: int) -> None:  #pylint: disable=unused-argument
+        counters[name.decode()] = value
+    visit_cb = SERVER_COUNTER_VISIT_CB(_visit_cb)
+    func = beast_utils_dll.get_server_counters
+    func.argtypes = [SERVER_COUNTER_VISIT_CB, c_uint]
+    func(visit_cb, 0)
+    return counters
+
 ######################################## tasks ########################################
 
 TASK_CB_TYPE = ctypes.CFUNCTYPE(None, c_uint)
@@ -183,6 +395,134 @@ def set_ssl_handler(certificate_handler: callable, key_handler: callable, db_han
                                  SSL_PASSWORD_HANDLER(_password_handler_wrapper))
     beast_utils_dll.set_ssl_handler(*current_function.handlers)
 
+def ssl_set_session_resumption(cache_size: int = 20 * 1024, session_timeout: int = 2 * 60 * 60, tickets: bool = True,
+                               ticket_key_rotation: int = 60 * 60) -> None:
+    """set TLS session resumption, it must be called before run_server
+
+    Args:
+        cache_size: the sessions cached by the server, 0 disables the cache
+        session_timeout: the lifetime(seconds) of a cached session or a ticket
+        tickets: issue stateless session tickets
+        ticket_key_rotation: the rotation interval(seconds) of the ticket keys, 0 means never
+
+    """
+    func = beast_utils_dll.ssl_set_session_resumption
+    func.argtypes = [ctypes.c_uint32, ctypes.c_uint32, ctypes.c_bool, ctypes.c_uint32]
+    func(cache_size, session_timeout, tickets, ticket_key_rotation)
+
+def ssl_get_resumption_stats() -> dict:
+    """Get the TLS session resumption statistics
+
+    Returns:
+        return {'full', 'resumed', 'resumption_rate', 'full_handshake_us', 'resumed_handshake_us', 'cpu_saved_ms', 'ticket_key_rotations'}
+
+    """
+    counters = get_server_counters()
+    full, resumed = counters.get('ssl_handshakes_full', 0), counters.get('ssl_handshakes_resumed', 0)
+    full_us = counters.get('ssl_handshake_full_nanoseconds', 0) / full / 1000 if full else 0.0
+    resumed_us = counters.get('ssl_handshake_resumed_nanoseconds', 0) / resumed / 1000 if resumed else 0.0
+    return {
+        'full': full,
+        'resumed': resumed,
+        'resumption_rate': resumed / (full + resumed) if full + resumed else 0.0,
+        'full_handshake_us': full_us,
+        'resumed_handshake_us': resumed_us,
+        'cpu_saved_ms': max(0.0, full_us - resumed_us) * resumed / 1000,
+        'ticket_key_rotations': counters.get('ssl_ticket_key_rotations', 0),
+    }
+
+def reload_ssl_context() -> bool:
+    """Reload the certificate through the ssl handler without restarting the server(thread-safe)
+
+    The new handshakes use the new certificate, the opened connections keep the former one until they close.
+
+    Returns:
+        return False if the server doesn't run with ssl or if the new certificate can't be loaded
+
+    """
+    func = beast_utils_dll.reload_ssl_context
+    func.restype = ctypes.c_bool
+    return func()
+
+SSL_PROFILE_LEGACY, SSL_PROFILE_INTERMEDIATE, SSL_PROFILE_MODERN = (0, 1, 2)
+def ssl_set_profile(profile: int, curves: str = None, ciphers: str = None, ciphersuites: str = None,  #pylint: disable=too-many-arguments
+                    prefer_server_ciphers: bool = True, dh: bool = None) -> None:
+    """set the security profile, it must be called before run_server
+
+    Args:
+        profile: SSL_PROFILE_LEGACY(TLS 1.2 with DH), SSL_PROFILE_INTERMEDIATE(TLS 1.3 + 1.2, ECDHE) or SSL_PROFILE_MODERN(TLS 1.3 only)
+        curves: the key exchange groups by preference, e.g. 'X25519:P-256', None for the default of the profile
+        ciphers: the TLS 1.2 cipher list, None for the default of the profile
+        ciphersuites: the TLS 1.3 cipher suites, None for the default of OpenSSL
+        prefer_server_ciphers: choose the cipher by the preference of the server
+        dh: load the DH parameters to allow the DHE ciphers, None means only for SSL_PROFILE_LEGACY
+
+    """
+    to_bytes = lambda content: content.encode() if isinstance(content, str) else content
+    func = beast_utils_dll.ssl_set_profile
+    func.argtypes = [ctypes.c_int32, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_bool, ctypes.c_bool]
+    func(profile, to_bytes(curves), to_bytes(ciphers), to_bytes(ciphersuites), prefer_server_ciphers,
+         (profile == SSL_PROFILE_LEGACY) if dh is None else dh)
+
+def ssl_set_handshake_pool(threads: int, max_concurrent_handshakes: int = 0) -> None:
+    """run the TLS connections on a dedicated pool of threads, it must be called before run_server
+
+    Args:
+        threads: the threads of the pool, 0 means the TLS connections run on the io threads
+        max_concurrent_handshakes: the handshakes at once, the others wait in arrival order, 0 means unlimited
+
+    """
+    func = beast_utils_dll.ssl_set_handshake_pool
+    func.argtypes = [ctypes.c_uint32, ctypes.c_uint32]
+    func(threads, max_concurrent_handshakes)
+
+def ssl_set_handshake_queue(max_waiting: int = 1024, wait_timeout_ms: int = 10 * 1000) -> None:
+    """bound the handshakes waiting for max_concurrent_handshakes, it must be called before run_server
+
+    Args:
+        max_waiting: the connections over it are closed at once, 0 means unlimited
+        wait_timeout_ms: the connections which waited longer are closed, 0 means unlimited
+
+    """
+    func = beast_utils_dll.ssl_set_handshake_queue
+    func.argtypes = [ctypes.c_uint32, ctypes.c_uint32]
+    func(max_waiting, wait_timeout_ms)
+
+def ssl_benchmark_handshakes(profile: int, dh: bool = None, handshake_count: int = 200) -> float:
+    """Run full handshakes in memory with a profile and measure the server side
+
+    Args:
+        profile: SSL_PROFILE_XXX, the lists set by ssl_set_profile are used
+        dh: load the DH parameters, None means only for SSL_PROFILE_LEGACY
+        handshake_count: the handshakes to run
+
+    Returns:
+        return the handshakes per second, 0 if the profile can't be set up
+
+    """
+    func = beast_utils_dll.ssl_benchmark_handshakes
+    func.restype = ctypes.c_double
+    func.argtypes = [ctypes.c_int32, ctypes.c_bool, ctypes.c_uint32]
+    return func(profile, (profile == SSL_PROFILE_LEGACY) if dh is None else dh, handshake_count)
+
+SESSION_DISPATCH_SHARED_FROM_THIS, SESSION_DISPATCH_HTTP_HANDLERS, SESSION_DISPATCH_WS_LOOKUP = (0, 1, 2)
+def session_benchmark_dispatch(operation: int, type_erased: bool, iterations: int = 1000000) -> float:
+    """Measure an operation of the session plumbing, it must not run with the server
+
+    Args:
+        operation: SESSION_DISPATCH_XXX
+        type_erased: True for the path of the former sessions (std::function, std::bind, dynamic_cast), False for the static one
+        iterations: the operations to run
+
+    Returns:
+        return the nanoseconds per operation, 0 if the operation is unknown
+
+    """
+    func = beast_utils_dll.session_benchmark_dispatch
+    func.restype = ctypes.c_double
+    func.argtypes = [ctypes.c_int32, ctypes.c_bool, ctypes.c_uint32]
+    return func(operation, type_erased, iterations)
+
 ######################################## http handles ########################################
 
 HTTP_HANDLER_CB = ctypes.CFUNCTYPE(None, c_uint, ctypes.c_char_p, ctypes.c_uint32)
@@ -214,6 +554,43 @@ def set_http_timeout_handler(handler) -> int:
     current_function.handler = handler_type(_handler_wrapper)
     beast_utils_dll.set_http_timeout_handler(current_function.handler, c_uint(0))
 
+def set_http_timeouts(idle: int = 0, header: int = 0, body: int = 0, write: int = 0) -> None:
+    """set the timeouts(seconds) of the phases of a request, it must be called before run_server. 0 keeps the timeout handler's
+
+    Args:
+        idle: waiting for the next request of a keep-alive connection
+        header: receiving the header, also the TLS detection and handshake of a new connection
+        body: receiving the body
+        write: sending a response
+
+    """
+    func = beast_utils_dll.set_http_timeouts
+    func.argtypes = [ctypes.c_uint32, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_uint32]
+    func(idle, header, body, write)
+
+def set_http_min_rates(read_bytes_per_second: int = 0, write_bytes_per_second: int = 0) -> None:
+    """drop the clients which send a request or read a response too slowly, it must be called before run_server
+
+    Args:
+        read_bytes_per_second: the deadline of the header and the body is extended by 1 s per this many bytes received
+        write_bytes_per_second: the deadline of a response is extended by 1 s per this many bytes
+
+    """
+    func = beast_utils_dll.set_http_min_rates
+    func.argtypes = [ctypes.c_uint32, ctypes.c_uint32]
+    func(read_bytes_per_second, write_bytes_per_second)
+
+def set_http_max_idle_connections(max_idle_connections: int = 0) -> None:
+    """cap the keep-alive connections waiting for their next request, it must be called before run_server
+
+    Args:
+        max_idle_connections: 0 means unlimited, over the cap the oldest idle connection is closed
+
+    """
+    func = beast_utils_dll.set_http_max_idle_connections
+    func.argtypes = [ctypes.c_uint32]
+    func(max_idle_connections)
+
 HTTP_BODY_LIMIT_HANDLER = ctypes.CFUNCTYPE(c_uint, c_uint, c_uint)
 def set_http_body_limit_handler(handler) -> int:
     """set http body limit handler
@@ -230,17 +607,137 @@ def set_http_body_limit_handler(handler) -> int:
 
 ######################################## ws handles ########################################
 
-def ws_connection_send(connection_handle: int, message: str) -> None:
+def ws_connection_send(connection_handle: int, message: str) -> bool:
     """Send message to ws connection
 
     Args:
         connection_handle: ws connection handle
         message: content
 
+    Returns:
+        return False if the connection has been closed
+
     """
     func = beast_utils_dll.ws_connection_send
+    func.restype = ctypes.c_bool
     func.argtypes = [c_uint, ctypes.c_char_p]
-    func(connection_handle, message.encode() if isinstance(message, str) else message)
+    return func(connection_handle, message.encode() if isinstance(message, str) else message)
+
+WS_OPCODE_TEXT, WS_OPCODE_BINARY = (1, 2)
+def ws_connection_send_data(connection_handle: int, data: bytes, opcode: int = WS_OPCODE_BINARY) -> bool:
+    """Send a length-delimited message to ws connection
+
+    Args:
+        connection_handle: ws connection handle
+        data: content, it may contain NUL characters
+        opcode: WS_OPCODE_TEXT or WS_OPCODE_BINARY
+
+    Returns:
+        return False if the connection has been closed
+
+    """
+    func = beast_utils_dll.ws_connection_send_data
+    func.restype = ctypes.c_bool
+    func.argtypes = [c_uint, ctypes.c_char_p, ctypes.c_uint32, ctypes.c_int32]
+    data = data.encode() if isinstance(data, str) else data
+    return func(connection_handle, data, len(data), opcode)
+
+WS_QUEUE_DROP_OLDEST, WS_QUEUE_CLOSE, WS_QUEUE_CONFLATE = (0, 1, 2)
+def ws_set_write_queue_limit(high_water_bytes: int, overflow_policy: int = WS_QUEUE_DROP_OLDEST) -> None:
+    """set the high-water mark of the outbound queue of every connection
+
+    Args:
+        high_water_bytes: the max bytes queued by a connection, 0 means unlimited
+        overflow_policy: WS_QUEUE_DROP_OLDEST, WS_QUEUE_CLOSE(close the slow consumer) or WS_QUEUE_CONFLATE(keep the latest message per key)
+
+    """
+    func = beast_utils_dll.ws_set_write_queue_limit
+    func.argtypes = [ctypes.c_uint32, ctypes.c_int32]
+    func(high_water_bytes, overflow_policy)
+
+def ws_set_permessage_deflate(enable: bool = True, window_bits: int = 15, mem_level: int = 4, comp_level: int = 6,  #pylint: disable=too-many-arguments
+                              no_context_takeover: bool = False, min_size: int = 0) -> None:
+    """set permessage-deflate, it must be called before run_server
+
+    Args:
+        enable: negotiate permessage-deflate with the clients which offer it
+        window_bits: 9~15, with mem_level the memory held by every connection is about 5 * 2**window_bits + 2**(mem_level + 9) bytes
+        mem_level: 1~9
+        comp_level: 0~9, the CPU spent against the ratio
+        no_context_takeover: release the window after each message, it saves memory but worsens the ratio of small messages
+        min_size: the messages below it are sent uncompressed(requires boost 1.76 or later)
+
+    """
+    func = beast_utils_dll.ws_set_permessage_deflate
+    func.argtypes = [ctypes.c_bool, ctypes.c_int32, ctypes.c_int32, ctypes.c_int32, ctypes.c_bool, ctypes.c_uint32]
+    func(enable, window_bits, mem_level, comp_level, no_context_takeover, min_size)
+
+def ws_get_deflate_stats() -> dict:
+    """Get the permessage-deflate statistics, the ratio and the CPU time are estimated by sampling
+
+    Returns:
+        return {'messages', 'raw_bytes', 'ratio', 'cpu_us_per_kb', 'memory_per_connection'}
+
+    """
+    counters = get_server_counters()
+    sampled_raw_bytes = counters.get('ws_deflate_sampled_raw_bytes', 0)
+    sampled_compressed_bytes = counters.get('ws_deflate_sampled_compressed_bytes', 0)
+    sampled_cpu_nanoseconds = counters.get('ws_deflate_sampled_cpu_nanoseconds', 0)
+    return {
+        'messages': counters.get('ws_deflate_messages', 0),
+        'raw_bytes': counters.get('ws_deflate_raw_bytes', 0),
+        'ratio': (sampled_compressed_bytes / sampled_raw_bytes) if sampled_raw_bytes else 1.0,
+        'cpu_us_per_kb': (sampled_cpu_nanoseconds / sampled_raw_bytes * 1024 / 1000) if sampled_raw_bytes else 0.0,
+        'memory_per_connection': counters.get('ws_deflate_memory_per_connection', 0),
+    }
+
+def ws_connection_send_keyed(connection_handle: int, key: str, message: bytes) -> bool:
+    """Send message to ws connection, the message can be conflated with the unsent one of the same key
+
+    Args:
+        connection_handle: ws connection handle
+        key: conflation key
+        message: content
+
+    Returns:
+        return False if the connection has been closed
+
+    """
+    func = beast_utils_dll.ws_connection_send_keyed
+    func.restype = ctypes.c_bool
+    func.argtypes = [c_uint, ctypes.c_char_p, ctypes.c_char_p]
+    to_bytes = lambda content: content.encode() if isinstance(content, str) else content
+    return func(connection_handle, to_bytes(key), to_bytes(message))
+
+def ws_connection_queued_bytes(connection_handle: int) -> int:
+    """Get the bytes queued by the connection, it can be used to throttle the producer
+
+    Args:
+        connection_handle: ws connection handle
+
+    Returns:
+        return the queued bytes or -1 if the connection has been closed
+
+    """
+    func = beast_utils_dll.ws_connection_queued_bytes
+    func.restype = ctypes.c_int64
+    func.argtypes = [c_uint]
+    return func(connection_handle)
+
+def ws_connection_memory(connection_handle: int) -> int:
+    """Get an estimate of the memory held by the connection: the session, its read buffer, its outbound queue and its zlib state
+
+    Args:
+        connection_handle: ws connection handle
+
+    Returns:
+        return the bytes or -1 if the connection has been closed
+
+    """
+    func = beast_utils_dll.ws_connection_memory
+    func.restype = ctypes.c_int64
+    func.argtypes = [c_uint]
+    return func(connection_handle)
 
 WS_MESSAGE_HANDLER = ctypes.CFUNCTYPE(None, c_uint, c_uint, ctypes.c_char_p)
 def ws_set_message_handler(handler) -> None:
@@ -256,6 +753,48 @@ def ws_set_message_handler(handler) -> None:
     current_function.handler = handler_type(_handler_wrapper)
     beast_utils_dll.ws_set_message_handler(current_function.handler, c_uint(0))
 
+WS_DATA_MESSAGE_HANDLER = ctypes.CFUNCTYPE(None, c_uint, c_uint, ctypes.c_void_p, ctypes.c_uint32, ctypes.c_int32)
+def ws_set_data_message_handler(handler) -> None:
+    """set the length-aware ws message handler, it takes the place of the message handler
+
+    Args:
+        handler: def data_message_handler(connection_handle: int, message: bytes, opcode: int) -> None
+
+    """
+    current_function, handler_type = ws_set_data_message_handler, WS_DATA_MESSAGE_HANDLER
+    def _handler_wrapper(user_data, connection_handle: int, data, data_size: int, opcode: int):  #pylint: disable=unused-argument
+        handler(connection_handle, ctypes.string_at(data, data_size) if data_size else b'', opcode)
+    current_function.handler = handler_type(_handler_wrapper)
+    beast_utils_dll.ws_set_data_message_handler(current_function.handler, c_uint(0))
+
+def ws_set_read_message_max(max_bytes: int) -> None:
+    """set the max size of an inbound message(16MB by default), a larger message closes the connection
+
+    Args:
+        max_bytes: the max size, 0 means unlimited
+
+    """
+    func = beast_utils_dll.ws_set_read_message_max
+    func.argtypes = [ctypes.c_uint64]
+    func(max_bytes)
+
+WS_CHUNK_HANDLER = ctypes.CFUNCTYPE(None, c_uint, c_uint, ctypes.c_void_p, ctypes.c_uint32, ctypes.c_int32, ctypes.c_bool)
+def ws_set_chunk_handler(handler, chunk_size: int = 64 * 1024) -> None:
+    """stream the inbound messages frame by frame in bounded memory, it takes the place of the message handlers
+
+    Args:
+        handler: def chunk_handler(connection_handle: int, chunk: bytes, opcode: int, is_final: bool) -> None, None to receive whole messages
+        chunk_size: the max size of a chunk
+
+    """
+    current_function, handler_type = ws_set_chunk_handler, WS_CHUNK_HANDLER
+    def _handler_wrapper(user_data, connection_handle: int, data, data_size: int, opcode: int, is_final: bool):  #pylint: disable=unused-argument, too-many-arguments
+        handler(connection_handle, ctypes.string_at(data, data_size) if data_size else b'', opcode, is_final)
+    current_function.handler = handler_type(_handler_wrapper) if handler else ctypes.cast(None, WS_CHUNK_HANDLER)
+    func = beast_utils_dll.ws_set_chunk_handler
+    func.argtypes = [WS_CHUNK_HANDLER, c_uint, ctypes.c_uint32]
+    func(current_function.handler, 0, chunk_size)
+
 WS_OPEN_HANDLER = ctypes.CFUNCTYPE(None, c_uint, c_uint)
 def ws_set_open_handler(handler) -> None:
     """set ws open handler
@@ -266,7 +805,6 @@ def ws_set_open_handler(handler) -> None:
     """
     current_function, handler_type = ws_set_open_handler, WS_OPEN_HANDLER
     def _handler_wrapper(user_data, connection_handle: int):  #pylint: disable=unused-argument
-        ws_connection_register(connection_handle)
         handler(connection_handle)
     current_function.handler = handler_type(_handler_wrapper)
     beast_utils_dll.ws_set_open_handler(current_function.handler, c_uint(0))
@@ -282,26 +820,133 @@ def ws_set_close_handler(handler) -> None:
     current_function, handler_type = ws_set_close_handler, WS_CLOSE_HANDLER
     def _handler_wrapper(user_data, connection_handle: int):  #pylint: disable=unused-argument
         handler(connection_handle)
-        ws_connection_unregister(connection_handle)
     current_function.handler = handler_type(_handler_wrapper)
     beast_utils_dll.ws_set_close_handler(current_function.handler, c_uint(0))
 
+######################################## async bridge ########################################
+
+ASYNC_EVENT_HTTP_REQUEST, ASYNC_EVENT_WS_OPEN, ASYNC_EVENT_WS_MESSAGE, ASYNC_EVENT_WS_CLOSE, ASYNC_EVENT_WS_BINARY_MESSAGE = (1, 2, 3, 4, 5)
+ASYNC_BRIDGE_WAKEUP_HANDLER = ctypes.CFUNCTYPE(None, c_uint)
+ASYNC_EVENT_HANDLER = ctypes.CFUNCTYPE(None, c_uint, ctypes.c_int32, c_uint, ctypes.c_void_p, ctypes.c_uint32, ctypes.c_void_p, ctypes.c_uint32)  #pylint: disable=line-too-long
+def async_bridge_attach(loop, http_handler=None, ws_message_handler=None, ws_open_handler=None, ws_close_handler=None) -> None:
+    """Dispatch the http requests and the ws events to an asyncio loop instead of the io threads
+
+    Every handler may be a plain function or a coroutine function(`async def`). It must be called before run_server.
+
+    Args:
+        loop: the asyncio event loop
+        http_handler: async def _(raw_head: bytes, raw_body: bytes) -> bytes: return the raw response
+        ws_message_handler: async def _(connection_handle: int, message: bytes) -> None
+        ws_open_handler: async def _(connection_handle: int) -> None
+        ws_close_handler: async def _(connection_handle: int) -> None
+
+    """
+    current_function = async_bridge_attach
+    async def _call_handler(handler, *args):
+        result = handler(*args)
+        return (await result) if inspect.isawaitable(result) else result
+    async def _http_task(request_handle: int, raw_head: bytes, raw_body: bytes) -> None:
+        # The session waits for the answer: a failed handler is answered with a 500
+        try:
+            response_value = await _call_handler(http_handler, raw_head, raw_body)
+        except Exception:  #pylint: disable=broad-except
+            traceback.print_exc()
+            response_value = b'HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n'
+        async_http_respond(request_handle, response_value)
+    def _event_handler(user_data, event_type: int, handle: int, head, head_size: int, body, body_size: int):  #pylint: disable=unused-argument, too-many-arguments
+        raw_head = ctypes.string_at(head, head_size) if head_size else b''
+        raw_body = ctypes.string_at(body, body_size) if body_size else b''
+        if event_type == ASYNC_EVENT_HTTP_REQUEST and http_handler:
+            loop.create_task(_http_task(handle, raw_head, raw_body))
+        elif event_type in (ASYNC_EVENT_WS_MESSAGE, ASYNC_EVENT_WS_BINARY_MESSAGE) and ws_message_handler:
+            loop.create_task(_call_handler(ws_message_handler, handle, raw_body))
+        elif event_type == ASYNC_EVENT_WS_OPEN and ws_open_handler:
+            loop.create_task(_call_handler(ws_open_handler, handle))
+        elif event_type == ASYNC_EVENT_WS_CLOSE and ws_close_handler:
+            loop.create_task(_call_handler(ws_close_handler, handle))
+    def _drain() -> None:
+        func = beast_utils_dll.async_bridge_poll
+        func.restype = ctypes.c_uint32
+        func.argtypes = [ASYNC_EVENT_HANDLER, c_uint, ctypes.c_uint32]
+        func(current_function.event_handler, 0, 0)
+    def _wakeup_handler(user_data) -> None:  #pylint: disable=unused-argument
+        loop.call_soon_threadsafe(_drain)
+    current_function.event_handler = ASYNC_EVENT_HANDLER(_event_handler)
+    current_function.wakeup_handler = ASYNC_BRIDGE_WAKEUP_HANDLER(_wakeup_handler)
+    func = beast_utils_dll.async_bridge_enable
+    func.restype = ctypes.c_int
+    func.argtypes = [ASYNC_BRIDGE_WAKEUP_HANDLER, c_uint]
+    event_fd = func(current_function.wakeup_handler, 0)
+    if event_fd >= 0:
+        loop.add_reader(event_fd, _drain)
+    current_function.event_fd = event_fd
+
+def async_bridge_detach(loop) -> None:
+    """Stop dispatching to the asyncio loop
+
+    Args:
+        loop: the asyncio event loop passed to async_bridge_attach
+
+    """
+    event_fd = getattr(async_bridge_attach, 'event_fd', -1)
+    if event_fd >= 0:
+        loop.remove_reader(event_fd)
+    async_bridge_attach.event_fd = -1
+    beast_utils_dll.async_bridge_disable()
+
+CODEL_POLICY_LIFO, CODEL_POLICY_SHED = (0, 1)
+def async_bridge_set_codel(target_ms: int = 5, interval_ms: int = 100, policy: int = CODEL_POLICY_LIFO) -> None:
+    """shed the http requests which wait too long for the asyncio loop(CoDel), it must be called before run_server
+
+    Args:
+        target_ms: the acceptable wait in the queue, 0 disables the control
+        interval_ms: the queue is overloaded when the requests wait longer than the target for this long, then the
+                     requests queued for more than an interval get a 503
+        policy: CODEL_POLICY_LIFO(serve the newest requests first) or CODEL_POLICY_SHED(a 503 to the new requests)
+
+    """
+    func = beast_utils_dll.async_bridge_set_codel
+    func.argtypes = [ctypes.c_uint32, ctypes.c_uint32, ctypes.c_int32]
+    func(target_ms, interval_ms, policy)
+
+def async_http_respond(request_handle: int, response_value: bytes) -> bool:
+    """Answer an http request queued by the async bridge(thread-safe)
+
+    Args:
+        request_handle: the request handle
+        response_value: the raw response
+
+    Returns:
+        return False if the request is unknown
+
+    """
+    func = beast_utils_dll.async_http_respond
+    func.restype = ctypes.c_bool
+    func.argtypes = [c_uint, ctypes.c_char_p, ctypes.c_uint32]
+    response_value = response_value.encode() if isinstance(response_value, str) else response_value
+    return func(request_handle, response_value, len(response_value))
+
 ######################################## ws extension utils ########################################
 
+WS_CONNECTION_VISIT_CB = ctypes.CFUNCTYPE(ctypes.c_bool, c_uint, c_uint)
 def ws_connections_visit(visit_cb):
     """visit all ws connection
 
     Args:
-        visit_cb: visit callback: def _(connection_handle)
+        visit_cb: visit callback: def _(connection_handle): return a true value to stop
+
+    Returns:
+        return the first true value returned by visit_cb or None
 
     """
-    lock_instance, ws_connection_dict = _get_ws_connections_pair()
-    with lock_instance:
-        for connection_handle in ws_connection_dict:
-            result = visit_cb(connection_handle)
-            if result:
-                return result
-        return None
+    result_list = []
+    def _visit_wrapper(user_data, connection_handle: int) -> bool:  #pylint: disable=unused-argument
+        result = visit_cb(connection_handle)
+        if result:
+            result_list.append(result)
+        return bool(result)
+    beast_utils_dll.ws_connections_visit(WS_CONNECTION_VISIT_CB(_visit_wrapper), c_uint(0))
+    return result_list[0] if result_list else None
 
 def ws_connection_has(connection_handle: int) -> bool:
     """Check if the connection exists
@@ -313,83 +958,143 @@ def ws_connection_has(connection_handle: int) -> bool:
         return whether the connection exists
 
     """
-    lock_instance, ws_connection_dict = _get_ws_connections_pair()
-    with lock_instance:
-        return ws_connection_dict.get(connection_handle)
+    func = beast_utils_dll.ws_connection_exists
+    func.restype = ctypes.c_bool
+    func.argtypes = [c_uint]
+    return func(connection_handle)
 
-def ws_connection_set_name(connection_handle: int, name: str) -> None:
-    """set the connection's name
+def ws_connection_count() -> int:
+    """Get the count of the opened connections
+
+    Returns:
+        return the count of the opened connections
+
+    """
+    func = beast_utils_dll.ws_connection_count
+    func.restype = ctypes.c_uint32
+    return func()
+
+def ws_connection_set_attribute(connection_handle: int, key: str, value: str) -> bool:
+    """set an attribute of the connection
 
     Args:
         connection_handle: connection's handle
-        name:  connection's name
+        key: attribute's name
+        value: attribute's value, None or empty to remove the attribute
+
+    Returns:
+        return False if the connection has been closed
 
     """
-    lock_instance, ws_connection_dict = _get_ws_connections_pair()
-    with lock_instance:
-        ws_connection_dict[connection_handle] = name.decode() if isinstance(name, bytes) else name
+    func = beast_utils_dll.ws_connection_set_attribute
+    func.restype = ctypes.c_bool
+    func.argtypes = [c_uint, ctypes.c_char_p, ctypes.c_char_p]
+    to_bytes = lambda content: content.encode() if isinstance(content, str) else content
+    return func(connection_handle, to_bytes(key), to_bytes(value))
 
-def ws_connection_register(connection_handle: int) -> None:
-    """register the connection
+def ws_connection_get_attribute(connection_handle: int, key: str) -> str:
+    """Get an attribute of the connection
 
     Args:
         connection_handle: connection's handle
+        key: attribute's name
 
-    """
-    lock_instance, ws_connection_dict = _get_ws_connections_pair()
-    with lock_instance:
-        ws_connection_dict[connection_handle] = ''
+    Returns:
+        return the attribute's value or None
 
-def ws_connection_unregister(connection_handle: int) -> None:
-    """Remove the connection
+    """
+    func = beast_utils_dll.ws_connection_get_attribute
+    func.restype = ctypes.c_int32
+    func.argtypes = [c_uint, ctypes.c_char_p, ctypes.POINTER(ctypes.c_char), ctypes.c_uint32]
+    key = key.encode() if isinstance(key, str) else key
+    buffer_size = 256
+    while True:
+        buffer = ctypes.create_string_buffer(buffer_size)
+        value_size = func(connection_handle, key, buffer, buffer_size)
+        if value_size < 0:
+            return None
+        if value_size <= buffer_size:
+            return buffer.raw[:value_size].decode()
+        buffer_size = value_size
+
+def ws_subscribe(connection_handle: int, topic: str) -> bool:
+    """subscribe the connection to a topic
 
     Args:
         connection_handle: connection's handle
+        topic: topic's name
+
+    Returns:
+        return False if the connection has been closed
 
     """
-    lock_instance, ws_connection_dict = _get_ws_connections_pair()
-    with lock_instance:
-        if connection_handle in ws_connection_dict:
-            del ws_connection_dict[connection_handle]
+    func = beast_utils_dll.ws_subscribe
+    func.restype = ctypes.c_bool
+    func.argtypes = [c_uint, ctypes.c_char_p]
+    return func(connection_handle, topic.encode() if isinstance(topic, str) else topic)
 
-def ws_connection_get_name(connection_handle: int) -> str:
-    """Get the connection's name
+def ws_unsubscribe(connection_handle: int, topic: str) -> bool:
+    """unsubscribe the connection from a topic
 
     Args:
         connection_handle: connection's handle
+        topic: topic's name
 
     Returns:
-        return the connection's name
+        return False if the connection didn't subscribe the topic
 
     """
-    lock_instance, ws_connection_dict = _get_ws_connections_pair()
-    with lock_instance:
-        return ws_connection_dict.get(connection_handle)
+    func = beast_utils_dll.ws_unsubscribe
+    func.restype = ctypes.c_bool
+    func.argtypes = [c_uint, ctypes.c_char_p]
+    return func(connection_handle, topic.encode() if isinstance(topic, str) else topic)
 
-def ws_connections_broadcast(origin_connection_handle: int, message: bytes, broadcast_origin: bool = False):
-    """broadcast message
+def ws_broadcast(topic: str, message: bytes, exclude_connection_handle: int = 0) -> int:
+    """broadcast message to the subscribers of a topic
 
     Args:
-        origin_connection_handle: origin connection's handle
+        topic: topic's name, None to broadcast to all the connections
         message: content
-        broadcast_origin: whether the broadcast contain itself
+        exclude_connection_handle: the connection which doesn't receive the message
+
+    Returns:
+        return the count of the recipients
 
     """
-    def _visit_cb(filter_cb, message: bytes, connection_handle: int) -> None:
-        if filter_cb(connection_handle):
-            ws_connection_send(connection_handle, message)
-    filter_cb = lambda connection_handle: broadcast_origin or (connection_handle != origin_connection_handle)
-    ws_connections_visit(functools.partial(_visit_cb, filter_cb, message))
+    func = beast_utils_dll.ws_broadcast
+    func.restype = ctypes.c_uint32
+    func.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_uint32, c_uint]
+    topic = topic.encode() if isinstance(topic, str) else topic
+    message = message.encode() if isinstance(message, str) else message
+    return func(topic, message, len(message), exclude_connection_handle)
 
-######################################## implements ########################################
+def ws_broadcast_data(topic: str, data: bytes, opcode: int = WS_OPCODE_BINARY, exclude_connection_handle: int = 0) -> int:
+    """broadcast a length-delimited message to the subscribers of a topic
 
-def _get_ws_connections_pair() -> tuple:
-    """ get ws connection
+    Args:
+        topic: topic's name, None to broadcast to all the connections
+        data: content
+        opcode: WS_OPCODE_TEXT or WS_OPCODE_BINARY
+        exclude_connection_handle: the connection which doesn't receive the message
 
     Returns:
-        return ({lock_instance: threading.Lock}, {ws_connection_dict: dict})
+        return the count of the recipients
+
+    """
+    func = beast_utils_dll.ws_broadcast_data
+    func.restype = ctypes.c_uint32
+    func.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_uint32, ctypes.c_int32, c_uint]
+    topic = topic.encode() if isinstance(topic, str) else topic
+    data = data.encode() if isinstance(data, str) else data
+    return func(topic, data, len(data), opcode, exclude_connection_handle)
+
+def ws_connections_broadcast(origin_connection_handle: int, message: bytes, broadcast_origin: bool = False):
+    """broadcast message
+
+    Args:
+        origin_connection_handle: origin connection's handle
+        message: content
+        broadcast_origin: whether the broadcast contain itself
+
     """
-    func, tag_name = (_get_ws_connections_pair, '__cached')
-    if not hasattr(func, tag_name):
-        setattr(func, tag_name, (threading.Lock(), {}))
-    return getattr(func, tag_name)
+    ws_broadcast(None, message, 0 if broadcast_origin else origin_connection_handle)
@@ -301,7 +301,7 @@ def _ws_close_handler(connection_handle: int) -> None:
         connection_handle: websocket connection handle
 
     """
-    connection_name = model.ws_connection_get_name(connection_handle)
+    connection_name = model.ws_connection_get_attribute(connection_handle, 'name')
     log.info('    ws(%s: %s) closed!', connection_name or '', connection_handle)
     model.ws_connections_broadcast(connection_handle, f'{connection_name} logout.', False)
 
@@ -313,12 +313,12 @@ def _handle_ws_message(connection_handle: int, message: bytes):
         message: message content
 
     """
-    if not model.ws_connection_get_name(connection_handle):  # Initialize connection name(The first message)
-        model.ws_connection_set_name(connection_handle, message)
+    if not model.ws_connection_get_attribute(connection_handle, 'name'):  # Initialize connection name(The first message)
+        model.ws_connection_set_attribute(connection_handle, 'name', message)
         log.info('    ws(%s: %s)login!', message.decode(), connection_handle)
         model.ws_connections_broadcast(connection_handle, f'{message.decode()} login.', True)
     else:  # other message
-        log.info('    ws receive (%s) message: %s', model.ws_connection_get_name(connection_handle), message.decode())
+        log.info('    ws receive (%s) message: %s', model.ws_connection_get_attribute(connection_handle, 'name'), message.decode())
         model.ws_connections_broadcast(connection_handle, message, False)
 
 def _http_timeout_handle(connection_handle: int) -> int:
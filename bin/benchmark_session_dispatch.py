@@ -0,0 +1,33 @@
+#!/usr/bin/python3.8
+# -*- coding: utf-8 -*-
+
+"""Compare the session plumbing of the handler policies with the type-erased path of the former sessions
+
+The sessions aren't connected and the handlers do nothing: only the dispatch is measured (std::function and std::bind
+against the calls bound at compile time, dynamic_cast against the static casts and the typed registry).
+
+    python3 benchmark_session_dispatch.py [iterations]
+
+"""
+
+import sys
+import beast_utils as model
+
+OPERATIONS = (
+    ('shared_from_this', model.SESSION_DISPATCH_SHARED_FROM_THIS),
+    ('HTTP handlers of a request', model.SESSION_DISPATCH_HTTP_HANDLERS),
+    ('ws_connection_send lookup', model.SESSION_DISPATCH_WS_LOOKUP),
+)
+
+def main(iterations: int) -> None:
+    """run the benchmark"""
+    model.plugin_initialize()
+    print(f'{"":<32}{"type-erased":>14}{"static":>14}')
+    for name, operation in OPERATIONS:
+        type_erased = model.session_benchmark_dispatch(operation, True, iterations)
+        static = model.session_benchmark_dispatch(operation, False, iterations)
+        print(f'{name:<32}{type_erased:>11.1f} ns{static:>11.1f} ns{type_erased / static if static else 0:>8.2f}x')
+    model.plugin_final()
+
+if __name__ == '__main__':
+    main(int(sys.argv[1]) if len(sys.argv) > 1 else 1000000)
@@ -0,0 +1,108 @@
+#!/usr/bin/python3.8
+# -*- coding: utf-8 -*-
+
+"""Measure the effect of the socket options on the latency, over the loopback of the local machine
+
+Every row restarts the server with one option of the profile and measures:
+    request:  the round trip of a small request on a keep-alive connection
+    connect:  a new connection, its request and the response (TCP Fast Open sends the request with the SYN)
+    transfer: a 256KB response on a keep-alive connection
+
+The loopback has no NIC and no loss: the busy polling and the keepalive don't show here, and the buffers matter
+more on a link with a real bandwidth-delay product.
+
+    python3 benchmark_socket_options.py [request_count]
+
+"""
+
+import socket
+import sys
+import threading
+import time
+import beast_utils as model
+
+LARGE_BODY_SIZE = 256 * 1024
+SMALL_RESPONSE = b'HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok'
+LARGE_RESPONSE = b'HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n' % LARGE_BODY_SIZE + b'x' * LARGE_BODY_SIZE
+OPTIONS = (
+    # name, set_socket_options, set_listen_socket_options, set_tcp_keepalive
+    ('defaults', (), (), ()),
+    ('TCP_NODELAY', (True,), (), ()),
+    ('SO_SNDBUF/SO_RCVBUF 16KB', (False, 16 * 1024, 16 * 1024), (), ()),
+    ('SO_SNDBUF/SO_RCVBUF 1MB', (False, 1024 * 1024, 1024 * 1024), (), ()),
+    ('TCP_DEFER_ACCEPT 1s', (), (1,), ()),
+    ('TCP_FASTOPEN 256', (), (0, 256), ()),
+    ('keepalive 60s/10s x5', (), (), (60, 10, 5)),
+    ('SO_BUSY_POLL 50us', (False, 0, 0, 50), (), ()),
+)
+
+def _http_handler(user_data, header, body, response_cb) -> None:  #pylint: disable=unused-argument
+    response = LARGE_RESPONSE if header.startswith(b'GET /large') else SMALL_RESPONSE
+    response_cb(user_data, response, len(response))
+
+def _read_response(sock: socket.socket, size: int) -> None:
+    received = 0
+    while received < size:
+        received += len(sock.recv(size - received + 4096))
+
+def _percentiles(samples: list) -> tuple:
+    samples.sort()
+    return samples[len(samples) // 2] * 1e6, samples[len(samples) * 99 // 100] * 1e6
+
+def _measure(port: int, request_count: int, fastopen: bool) -> tuple:
+    request = b'GET / HTTP/1.1\r\nHost: bench\r\n\r\n'
+    sock = socket.create_connection(('127.0.0.1', port))
+    round_trips = []
+    for _ in range(request_count):
+        start = time.perf_counter()
+        sock.sendall(request)
+        _read_response(sock, len(SMALL_RESPONSE))
+        round_trips.append(time.perf_counter() - start)
+
+    transfers = []
+    for _ in range(max(1, request_count // 10)):
+        start = time.perf_counter()
+        sock.sendall(b'GET /large HTTP/1.1\r\nHost: bench\r\n\r\n')
+        _read_response(sock, len(LARGE_RESPONSE))
+        transfers.append(time.perf_counter() - start)
+    sock.close()
+
+    connects = []
+    for _ in range(max(1, request_count // 5)):
+        start = time.perf_counter()
+        if fastopen and hasattr(socket, 'MSG_FASTOPEN'):
+            sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            sock.sendto(request, socket.MSG_FASTOPEN, ('127.0.0.1', port))
+        else:
+            sock = socket.create_connection(('127.0.0.1', port))
+            sock.sendall(request)
+        _read_response(sock, len(SMALL_RESPONSE))
+        connects.append(time.perf_counter() - start)
+        sock.close()
+    return _percentiles(round_trips), _percentiles(connects), _percentiles(transfers)
+
+def main(request_count: int) -> None:
+    """run the benchmark"""
+    model.plugin_initialize()
+    model.set_log_reporting_level(3)
+    print(f'{"":<28}{"request p50/p99 us":>22}{"connect p50/p99 us":>22}{"transfer p50/p99 us":>24}')
+    for index, (name, socket_options, listen_options, keepalive) in enumerate(OPTIONS):
+        # The options belong to the server: they are set again for every run
+        port = 18600 + index
+        model.set_http_handler(_http_handler)
+        model.set_socket_options(*socket_options)
+        model.set_listen_socket_options(*listen_options)
+        if keepalive:
+            model.set_tcp_keepalive(*keepalive)
+        server = threading.Thread(target=model.run_server, args=(port, False, 1))
+        server.start()
+        time.sleep(0.3)
+        request, connect, transfer = _measure(port, request_count, bool(listen_options[1:]))
+        model.shutdown_server()
+        server.join()
+        print(f'{name:<28}{request[0]:>11.0f}/{request[1]:<10.0f}{connect[0]:>11.0f}/{connect[1]:<10.0f}'
+              f'{transfer[0]:>12.0f}/{transfer[1]:<10.0f}')
+    model.plugin_final()
+
+if __name__ == '__main__':
+    main(int(sys.argv[1]) if len(sys.argv) > 1 else 2000)
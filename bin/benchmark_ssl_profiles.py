@@ -0,0 +1,40 @@
+#!/usr/bin/python3.8
+# -*- coding: utf-8 -*-
+
+"""Compare the handshake rate of the security profiles on the local machine
+
+The full handshakes run in memory, only the CPU time of the server side is measured: the round trip saved by
+TLS 1.3 doesn't show here. The certificate of the ssl handler is used (the default one is a RSA 2048 key).
+
+    python3 benchmark_ssl_profiles.py [handshake_count]
+
+"""
+
+import sys
+import beast_utils as model
+
+DHE_CIPHERS = 'DHE-RSA-AES128-GCM-SHA256:DHE-RSA-AES256-GCM-SHA384'
+ECDHE_CIPHERS = 'ECDHE-RSA-AES128-GCM-SHA256:ECDHE-RSA-AES256-GCM-SHA384'
+PROFILES = (
+    # name, profile, curves, TLS 1.2 ciphers, dh
+    ('TLS 1.2, DHE ffdhe2048', model.SSL_PROFILE_LEGACY, None, DHE_CIPHERS, True),
+    ('TLS 1.2, ECDHE P-256', model.SSL_PROFILE_LEGACY, 'P-256', ECDHE_CIPHERS, False),
+    ('TLS 1.2, ECDHE X25519', model.SSL_PROFILE_LEGACY, 'X25519', ECDHE_CIPHERS, False),
+    ('TLS 1.3 + 1.2 (intermediate), X25519', model.SSL_PROFILE_INTERMEDIATE, None, None, False),
+    ('TLS 1.3 only (modern), P-256', model.SSL_PROFILE_MODERN, 'P-256', None, False),
+    ('TLS 1.3 only (modern), X25519', model.SSL_PROFILE_MODERN, None, None, False),
+)
+
+def main(handshake_count: int) -> None:
+    """run the benchmark"""
+    model.plugin_initialize()
+    baseline = 0.0
+    for name, profile, curves, ciphers, dh in PROFILES:
+        model.ssl_set_profile(profile, curves, ciphers, None, True, dh)
+        rate = model.ssl_benchmark_handshakes(profile, dh, handshake_count)
+        baseline = baseline or rate
+        print(f'{name:<40}{rate:>10.1f} handshakes/s{rate / baseline if baseline else 0:>8.2f}x')
+    model.plugin_final()
+
+if __name__ == '__main__':
+    main(int(sys.argv[1]) if len(sys.argv) > 1 else 200)
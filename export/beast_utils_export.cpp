@@ -2,12 +2,23 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
 #include "include/beast_utils.h"
 #include "src/app_resource.h"
+#include "src/async_bridge.h"
+#include "src/server_counters.h"
+#include "src/server_options.h"
+#include "src/session_benchmark.h"
+#include "src/ssl_benchmark.h"
+#include "src/ws_connection_registry.h"
 #include "base/utils.h"
 #include "base/memory_utils.hpp"
 #include "base/task_utils.hpp"
+#include "net/ws_deflate_sampler.h"
 
 //////////////////////////////////////// plugins ////////////////////////////////////////
 
@@ -36,6 +47,110 @@ BU_API void set_server_shutdown_handler(server_shutdown_handler_type handle_cb,
     scaffold_handles_get_instance()->server_shutdown_handler_pair = std::make_pair(handle_cb, user_data);
 }
 
+BU_API bool add_server_endpoint(const char* address, uint16_t port, int mode) {
+    boost::system::error_code ec;
+    if (!address || mode < ENDPOINT_MODE_PLAIN || mode > ENDPOINT_MODE_FLEX)
+        return false;
+    boost::asio::ip::make_address(address, ec);
+    if (ec)
+        return false;
+    server_options_get_instance()->endpoints.push_back(server_endpoint{ address, port, mode });
+    return true;
+}
+
+BU_API bool add_unix_endpoint(const char* path, uint32_t permissions) {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    // The size of sockaddr_un.sun_path, its terminating NUL included
+    const std::size_t path_max = sizeof(sockaddr_un::sun_path) - 1;
+    if (!path || !*path || std::strlen(path) > path_max)
+        return false;
+    server_options_get_instance()->unix_endpoints.push_back(server_unix_endpoint{ path, permissions });
+    return true;
+#else
+    return false;
+#endif
+}
+
+BU_API void clear_server_endpoints(void) {
+    server_options_get_instance()->endpoints.clear();
+    server_options_get_instance()->unix_endpoints.clear();
+}
+
+BU_API void set_socket_options(bool tcp_nodelay, uint32_t send_buffer, uint32_t receive_buffer, uint32_t busy_poll) {
+    auto options = server_options_get_instance();
+    options->tcp_nodelay = tcp_nodelay;
+    options->socket_send_buffer = send_buffer;
+    options->socket_receive_buffer = receive_buffer;
+    options->socket_busy_poll = busy_poll;
+}
+
+BU_API void set_listen_socket_options(uint32_t defer_accept, uint32_t fastopen_queue) {
+    server_options_get_instance()->tcp_defer_accept = defer_accept;
+    server_options_get_instance()->tcp_fastopen_queue = fastopen_queue;
+}
+
+BU_API void set_tcp_keepalive(uint32_t idle, uint32_t interval, uint32_t count) {
+    auto options = server_options_get_instance();
+    options->tcp_keepalive_idle = idle;
+    options->tcp_keepalive_interval = interval;
+    options->tcp_keepalive_count = count;
+}
+
+BU_API void set_listen_acceptors(uint32_t acceptor_count) {
+    server_options_get_instance()->listen_acceptors = std::max<uint32_t>(1, acceptor_count);
+}
+
+BU_API void set_admission_limits(uint32_t max_connections, uint32_t max_connections_per_ip, int overload_policy) {
+    auto options = server_options_get_instance();
+    options->max_connections = max_connections;
+    options->max_connections_per_ip = max_connections_per_ip;
+    options->overload_policy = overload_policy;
+}
+
+BU_API bool rate_limit_add_rule(const char* prefix, double rate, uint32_t burst) {
+    if (!prefix || !*prefix || !(rate > 0) || !burst)
+        return false;
+    server_options_get_instance()->rate_limit_rules.push_back(server_rate_rule{ prefix, rate, burst });
+    return true;
+}
+
+BU_API void rate_limit_clear_rules(void) {
+    server_options_get_instance()->rate_limit_rules.clear();
+}
+
+BU_API void rate_limit_set_key_header(const char* header) {
+    server_options_get_instance()->rate_limit_key_header = header ? header : "";
+}
+
+BU_API void rate_limit_set_max_buckets(uint32_t max_buckets) {
+    server_options_get_instance()->rate_limit_max_buckets = max_buckets;
+}
+
+BU_API void set_io_context_per_thread(bool enable, int distribution, const int32_t* cpus, uint32_t cpu_count) {
+    auto options = server_options_get_instance();
+    options->io_context_per_thread = enable;
+    options->io_distribution = distribution;
+    options->io_cpu_affinity.assign(cpus, cpus + (cpus ? cpu_count : 0));
+}
+
+BU_API void set_low_memory_mode(bool enable, uint32_t connection_buffer_max) {
+    server_options_get_instance()->low_memory = enable;
+    server_options_get_instance()->connection_buffer_max = connection_buffer_max;
+}
+
+BU_API void set_session_pool_cache(uint32_t cache_bytes_per_class) {
+    server_options_get_instance()->session_pool_cache_bytes = cache_bytes_per_class;
+}
+
+BU_API void set_handler_arena(bool enable) {
+    server_options_get_instance()->handler_arena = enable;
+}
+
+BU_API void get_server_counters(server_counter_visit_cb_type visit_cb, uintptr_t user_data) {
+    if (visit_cb)
+        server_counters_get_instance()->visit([visit_cb, user_data](const char* name, uint64_t value) { visit_cb(user_data, name, value); });
+}
+
 //////////////////////////////////////// tasks ////////////////////////////////////////
 
 BU_API void post_task(task_cb_type task, uintptr_t user_data, unsigned int delay_milliseconds) {
@@ -61,6 +176,49 @@ BU_API void set_ssl_handler(ssl_certificate_cb_type certificate_cb, ssl_key_cb_t
     scaffold_handles_get_instance()->ssl_password_handler = password_cb;
 }
 
+BU_API void ssl_set_session_resumption(uint32_t cache_size, uint32_t session_timeout, bool tickets, uint32_t ticket_key_rotation) {
+    auto options = server_options_get_instance();
+    options->ssl_session_cache_size = cache_size;
+    options->ssl_session_timeout = session_timeout;
+    options->ssl_session_tickets = tickets;
+    options->ssl_ticket_key_rotation = ticket_key_rotation;
+}
+
+BU_API bool reload_ssl_context(void) {
+    return app_resource_get_instance()->reload_ssl_context();
+}
+
+BU_API void ssl_set_profile(int profile, const char* curves, const char* ciphers, const char* ciphersuites, bool prefer_server_ciphers, bool dh) {
+    auto options = server_options_get_instance();
+    options->ssl_profile = profile;
+    options->ssl_curves = curves ? curves : "";
+    options->ssl_ciphers = ciphers ? ciphers : "";
+    options->ssl_ciphersuites = ciphersuites ? ciphersuites : "";
+    options->ssl_prefer_server_ciphers = prefer_server_ciphers;
+    options->ssl_dh = dh;
+}
+
+BU_API void ssl_set_handshake_pool(uint32_t threads, uint32_t max_concurrent_handshakes) {
+    server_options_get_instance()->ssl_handshake_threads = threads;
+    server_options_get_instance()->ssl_handshake_concurrency = max_concurrent_handshakes;
+}
+
+BU_API void ssl_set_handshake_queue(uint32_t max_waiting, uint32_t wait_timeout_milliseconds) {
+    server_options_get_instance()->ssl_handshake_max_waiting = max_waiting;
+    server_options_get_instance()->ssl_handshake_wait_timeout = wait_timeout_milliseconds;
+}
+
+BU_API double ssl_benchmark_handshakes(int profile, bool dh, uint32_t handshake_count) {
+    server_options options = *server_options_get_instance();
+    options.ssl_profile = profile;
+    options.ssl_dh = dh;
+    return benchmark_ssl_handshakes(options, handshake_count);
+}
+
+BU_API double session_benchmark_dispatch(int operation, bool type_erased, uint32_t iterations) {
+    return benchmark_session_dispatch(operation, type_erased, iterations);
+}
+
 //////////////////////////////////////// http handles ////////////////////////////////////////
 
 BU_API void set_http_handler(http_handler_type handle_cb, uintptr_t user_data) {
@@ -71,20 +229,127 @@ BU_API void set_http_timeout_handler(http_timeout_handler_type handle_cb, uintpt
     scaffold_handles_get_instance()->http_timeout_handler_pair = std::make_pair(handle_cb, user_data);
 }
 
+BU_API void set_http_timeouts(uint32_t idle, uint32_t header, uint32_t body, uint32_t write) {
+    auto options = server_options_get_instance();
+    options->http_idle_timeout = idle;
+    options->http_header_timeout = header;
+    options->http_body_timeout = body;
+    options->http_write_timeout = write;
+}
+
+BU_API void set_http_min_rates(uint32_t read_bytes_per_second, uint32_t write_bytes_per_second) {
+    server_options_get_instance()->http_min_read_rate = read_bytes_per_second;
+    server_options_get_instance()->http_min_write_rate = write_bytes_per_second;
+}
+
+BU_API void set_http_max_idle_connections(uint32_t max_idle_connections) {
+    server_options_get_instance()->http_max_idle_connections = max_idle_connections;
+}
+
 BU_API void set_http_body_limit_handler(http_body_limit_handler_type handle_cb, uintptr_t user_data) {
     scaffold_handles_get_instance()->http_body_limit_handler_pair = std::make_pair(handle_cb, user_data);
 }
 
 //////////////////////////////////////// ws handles ////////////////////////////////////////
 
-BU_API void ws_connection_send(uintptr_t connection, const char* message) {
-    ws_connection_send(object_handle_to_pointer(connection), message);
+BU_API bool ws_connection_send(uintptr_t connection, const char* message) {
+    return ws_send_message(connection, message);
+}
+
+BU_API bool ws_connection_exists(uintptr_t connection) {
+    return ws_connection_registry_get_instance()->exists(connection);
+}
+
+BU_API uint32_t ws_connection_count(void) {
+    return static_cast<uint32_t>(ws_connection_registry_get_instance()->count());
+}
+
+BU_API bool ws_connection_set_attribute(uintptr_t connection, const char* key, const char* value) {
+    return key && ws_connection_registry_get_instance()->set_attribute(connection, key, value ? value : "");
+}
+
+BU_API int32_t ws_connection_get_attribute(uintptr_t connection, const char* key, char* buffer, uint32_t buffer_size) {
+    std::string value;
+    if (!key || !ws_connection_registry_get_instance()->get_attribute(connection, key, &value))
+        return -1;
+    if (buffer && buffer_size)
+        std::memcpy(buffer, value.data(), std::min<std::size_t>(buffer_size, value.size()));
+    return static_cast<int32_t>(value.size());
+}
+
+BU_API bool ws_connection_send_data(uintptr_t connection, const char* data, uint32_t data_size, int opcode) {
+    return ws_send_message(connection, std::make_shared<const std::string>(data, data + data_size), std::string(), opcode == WS_OPCODE_BINARY);
+}
+
+BU_API void ws_set_write_queue_limit(uint32_t high_water_bytes, int overflow_policy) {
+    server_options_get_instance()->ws_write_queue_limit = high_water_bytes;
+    server_options_get_instance()->ws_write_queue_policy = overflow_policy;
+}
+
+BU_API void ws_set_permessage_deflate(bool enable, int window_bits, int mem_level, int comp_level, bool no_context_takeover, uint32_t min_size) {
+    auto options = server_options_get_instance();
+    options->ws_deflate_enable = enable;
+    // zlib can't use a window of 8 bits with a raw deflate stream
+    options->ws_deflate_window_bits = std::min(std::max(window_bits, 9), 15);
+    options->ws_deflate_mem_level = std::min(std::max(mem_level, 1), 9);
+    options->ws_deflate_comp_level = std::min(std::max(comp_level, 0), 9);
+    options->ws_deflate_no_context_takeover = no_context_takeover;
+    options->ws_deflate_min_size = min_size;
+    server_counters_get_instance()->set(server_counters::ws_deflate_memory_per_connection,
+        enable ? ws_deflate_memory_per_connection(options->ws_deflate_window_bits, options->ws_deflate_mem_level) : 0);
+}
+
+BU_API bool ws_connection_send_keyed(uintptr_t connection, const char* key, const char* message) {
+    return ws_send_message(connection, std::make_shared<const std::string>(message), key ? key : "");
+}
+
+BU_API int64_t ws_connection_queued_bytes(uintptr_t connection) {
+    return ws_queued_bytes(connection);
+}
+
+BU_API int64_t ws_connection_memory(uintptr_t connection) {
+    return ws_memory_bytes(connection);
+}
+
+BU_API bool ws_subscribe(uintptr_t connection, const char* topic) {
+    return topic && ws_connection_registry_get_instance()->subscribe(connection, topic);
+}
+
+BU_API bool ws_unsubscribe(uintptr_t connection, const char* topic) {
+    return topic && ws_connection_registry_get_instance()->unsubscribe(connection, topic);
+}
+
+BU_API uint32_t ws_broadcast(const char* topic, const char* data, uint32_t data_size, uintptr_t exclude_connection) {
+    return ws_broadcast_data(topic, data, data_size, WS_OPCODE_TEXT, exclude_connection);
+}
+
+BU_API uint32_t ws_broadcast_data(const char* topic, const char* data, uint32_t data_size, int opcode, uintptr_t exclude_connection) {
+    auto sp_message = std::make_shared<const std::string>(data, data + data_size);
+    return ws_broadcast_message(topic ? topic : "", sp_message, exclude_connection, opcode == WS_OPCODE_BINARY);
+}
+
+BU_API void ws_connections_visit(ws_connection_visit_cb_type visit_cb, uintptr_t user_data) {
+    if (visit_cb)
+        ws_connection_registry_get_instance()->visit([visit_cb, user_data](uintptr_t connection) { return visit_cb(user_data, connection); });
 }
 
 BU_API void ws_set_message_handler(ws_message_handler_type handle_cb, uintptr_t user_data) {
     scaffold_handles_get_instance()->ws_message_handler_pair = std::make_pair(handle_cb, user_data);
 }
 
+BU_API void ws_set_data_message_handler(ws_data_message_handler_type handle_cb, uintptr_t user_data) {
+    scaffold_handles_get_instance()->ws_data_message_handler_pair = std::make_pair(handle_cb, user_data);
+}
+
+BU_API void ws_set_read_message_max(uint64_t max_bytes) {
+    server_options_get_instance()->ws_read_message_max = max_bytes;
+}
+
+BU_API void ws_set_chunk_handler(ws_chunk_handler_type handle_cb, uintptr_t user_data, uint32_t chunk_size) {
+    scaffold_handles_get_instance()->ws_chunk_handler_pair = std::make_pair(handle_cb, user_data);
+    server_options_get_instance()->ws_read_chunk_size = handle_cb ? (chunk_size ? chunk_size : 64 * 1024) : 0;
+}
+
 BU_API void ws_set_open_handler(ws_open_handler_type handle_cb, uintptr_t user_data) {
     scaffold_handles_get_instance()->ws_open_handler_pair = std::make_pair(handle_cb, user_data);
 }
@@ -92,3 +357,25 @@ BU_API void ws_set_open_handler(ws_open_handler_type handle_cb, uintptr_t user_d
 BU_API void ws_set_close_handler(ws_close_handler_type handle_cb, uintptr_t user_data) {
     scaffold_handles_get_instance()->ws_close_handler_pair = std::make_pair(handle_cb, user_data);
 }
+
+//////////////////////////////////////// async bridge ////////////////////////////////////////
+
+BU_API int async_bridge_enable(async_bridge_wakeup_handler_type wakeup_cb, uintptr_t user_data) {
+    return async_bridge_get_instance()->enable(wakeup_cb, user_data);
+}
+
+BU_API void async_bridge_disable(void) {
+    async_bridge_get_instance()->disable();
+}
+
+BU_API uint32_t async_bridge_poll(async_event_handler_type handle_cb, uintptr_t user_data, uint32_t max_events) {
+    return handle_cb ? async_bridge_get_instance()->poll(handle_cb, user_data, max_events) : 0;
+}
+
+BU_API void async_bridge_set_codel(uint32_t target_milliseconds, uint32_t interval_milliseconds, int policy) {
+    async_bridge_get_instance()->set_codel(target_milliseconds, interval_milliseconds, policy);
+}
+
+BU_API bool async_http_respond(uintptr_t request_handle, const char* response_content, uint32_t response_size) {
+    return async_bridge_get_instance()->respond(request_handle, response_content, response_size);
+}
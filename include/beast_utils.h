@@ -45,6 +45,95 @@ BU_API void shutdown_server(void);
 typedef void (*server_shutdown_handler_type)(uintptr_t user_data);
 BU_API void set_server_shutdown_handler(server_shutdown_handler_type handle_cb, uintptr_t user_data);
 
+// The listening endpoints, they must be added before run_server and replace its port:
+//  address: an IPv4 or IPv6 address, e.g. "127.0.0.1", "::" or "0.0.0.0"
+//  mode: ENDPOINT_MODE_PLAIN or ENDPOINT_MODE_TLS build the session at once, ENDPOINT_MODE_FLEX detects TLS from the
+//        first bytes (the port of run_server). The TLS endpoints require run_server with ssl.
+// Returns false if the address or the mode is invalid.
+enum { ENDPOINT_MODE_PLAIN = 0, ENDPOINT_MODE_TLS, ENDPOINT_MODE_FLEX };
+BU_API bool add_server_endpoint(const char* address, uint16_t port, int mode);
+// Remove the TCP and the local endpoints
+BU_API void clear_server_endpoints(void);
+
+// A local (AF_UNIX) endpoint for a reverse proxy on the same host, it must be added before run_server and replaces
+// its port like add_server_endpoint. The connections are plain HTTP/WebSocket, there is no TLS detection.
+//  path: the socket file, a former socket file is replaced and removed when the server stops. A path beginning with
+//        '@' is in the abstract namespace (Linux): no file and no permissions.
+//  permissions: the mode of the socket file, e.g. 0660 for the group of the proxy, 0 keeps the umask
+// Returns false if the path is empty or too long, or if the platform has no local sockets.
+BU_API bool add_unix_endpoint(const char* path, uint32_t permissions);
+
+// The socket option profile of the TCP connections, it must be called before run_server. 0 keeps the default of the
+// system, the options unknown to the platform are skipped. See bin/benchmark_socket_options.py for their effect.
+//  tcp_nodelay: disable Nagle's algorithm on the connections
+//  send_buffer, receive_buffer: SO_SNDBUF / SO_RCVBUF (bytes), the receive buffer is also set on the acceptors
+//  busy_poll: SO_BUSY_POLL (microseconds), above net.core.busy_read it requires CAP_NET_ADMIN
+BU_API void set_socket_options(bool tcp_nodelay, uint32_t send_buffer, uint32_t receive_buffer, uint32_t busy_poll);
+//  defer_accept: TCP_DEFER_ACCEPT (seconds), the connection is accepted when its first data arrives
+//  fastopen_queue: TCP_FASTOPEN, the pending requests whose data came with the SYN
+BU_API void set_listen_socket_options(uint32_t defer_accept, uint32_t fastopen_queue);
+//  idle, interval: the seconds before the first keepalive probe and between the probes, count: the probes before
+//  the connection is dropped. An idle time of 0 disables the keepalive.
+BU_API void set_tcp_keepalive(uint32_t idle, uint32_t interval, uint32_t count);
+
+// The acceptors of the listening port, it must be called before run_server. More than one acceptor (typically the
+// concurrency hint of run_server) are bound with SO_REUSEPORT: the kernel balances the new connections between them
+// and they accept in parallel. A single acceptor is used if the platform doesn't support SO_REUSEPORT.
+BU_API void set_listen_acceptors(uint32_t acceptor_count);
+
+// The admission control of the connections, it must be called before run_server. 0 means unlimited.
+//  max_connections: the opened connections of the server (TCP and local)
+//  max_connections_per_ip: the opened connections of a client address, the new ones over the limit get a 503
+//  overload_policy: over max_connections, ADMISSION_REJECT answers the new connections with a 503 (Retry-After: 1,
+//                   the TLS clients are closed), ADMISSION_PAUSE stops accepting until the connections fall to 90%
+// The accept failures for lack of descriptors (EMFILE, ENFILE) or memory back off from 10 ms to 1 s.
+enum { ADMISSION_REJECT = 0, ADMISSION_PAUSE };
+BU_API void set_admission_limits(uint32_t max_connections, uint32_t max_connections_per_ip, int overload_policy);
+
+// The rate limits, they must be set before run_server. A request or a WebSocket message takes a token from the bucket
+// of its client for the longest matching route prefix, the routes without a rule are unlimited. Over the limit, a
+// request is answered with a 429 (Retry-After) and a message is dropped, neither reaches the handlers.
+//  prefix: the beginning of the target, e.g. "/api/" or "/" for all the routes
+//  rate, burst: the tokens per second, and the max tokens of a bucket (the requests at once)
+// Returns false if the prefix is empty, or if the rate or the burst is 0.
+BU_API bool rate_limit_add_rule(const char* prefix, double rate, uint32_t burst);
+BU_API void rate_limit_clear_rules(void);
+// The clients are told apart by their address and the value of this header (e.g. "X-Api-Key"), by their address only
+// if it's null or empty or if a request doesn't have it. The local (AF_UNIX) clients share their address.
+BU_API void rate_limit_set_key_header(const char* header);
+// The cap of the token buckets (100000 by default, 0: unlimited): a new client is refused with a 429 while the buckets
+// of the active clients are at the cap, reported by get_server_counters(rate_limit_buckets_full)
+BU_API void rate_limit_set_max_buckets(uint32_t max_buckets);
+
+// The execution model, it must be called before run_server. With io_context_per_thread, every io thread (the
+// concurrency hint of run_server) runs its own io_context and all the handlers of a connection run on one thread:
+//  distribution: IO_DISTRIBUTION_ROUND_ROBIN, or IO_DISTRIBUTION_LEAST_LOADED (the fewest opened connections)
+//  cpus: the thread i is pinned to cpus[i % cpu_count], no pinning if cpu_count is 0
+// The acceptor i runs on the io_context i; with an acceptor per io_context (set_listen_acceptors), the connections stay
+// on the one of their acceptor. The signals and the tasks run on the thread which calls run_server.
+enum { IO_DISTRIBUTION_ROUND_ROBIN = 0, IO_DISTRIBUTION_LEAST_LOADED };
+BU_API void set_io_context_per_thread(bool enable, int distribution, const int32_t* cpus, uint32_t cpu_count);
+
+// The low-memory mode for many idle connections, it must be called before run_server. The read buffers are released
+// after each message, an idle plain HTTP connection waits without one and OpenSSL releases its buffers while a TLS
+// connection is idle. connection_buffer_max caps the read buffer of a connection (0: unlimited): an HTTP header with the
+// pipelined requests, or a WebSocket message. The session_buffer_bytes counter sums the read buffers.
+BU_API void set_low_memory_mode(bool enable, uint32_t connection_buffer_max);
+
+// The sessions, their read buffers and their request headers are recycled by a free list per io thread and per size
+// class (64 bytes to 64 KB), each keeps up to cache_bytes_per_class bytes (256 KB by default, 0: no recycling). It must
+// be called before run_server. The session_pool_hits and session_pool_misses counters follow the reuse.
+BU_API void set_session_pool_cache(uint32_t cache_bytes_per_class);
+
+// The async operations of a session (its reads, writes, waits and handshakes) are allocated by a few slots of the
+// session, the larger ones and the ones over the slots by the session pool (enabled by default). It must be called before
+// run_server. The handler_arena_hits and handler_arena_misses counters over http_requests give the allocations per request.
+BU_API void set_handler_arena(bool enable);
+
+// The statistics counters of the server, the callback is called for each of them.
+typedef void (*server_counter_visit_cb_type)(uintptr_t user_data, const char* name, uint64_t value);
+BU_API void get_server_counters(server_counter_visit_cb_type visit_cb, uintptr_t user_data);
+
 //////////////////////////////////////// tasks ////////////////////////////////////////
 
 typedef void (*task_cb_type)(uintptr_t user_data);
@@ -65,6 +154,54 @@ typedef unsigned int (*ssl_dh_cb_type)(char* buffer, unsigned int buffer_size);
 typedef unsigned int (*ssl_password_cb_type)(bool is_write, char* buffer, unsigned int buffer_size);
 BU_API void set_ssl_handler(ssl_certificate_cb_type certificate_cb, ssl_key_cb_type key_cb, ssl_dh_cb_type dh_cb, ssl_password_cb_type password_cb);
 
+// TLS session resumption, it must be called before run_server. The resumption rate and the handshake time are
+// reported by get_server_counters(ssl_handshakes_xxx).
+//  cache_size: the sessions cached by the server, 0 disables the cache
+//  session_timeout: the lifetime (seconds) of a cached session or a ticket
+//  tickets: issue stateless session tickets, their keys are rotated every ticket_key_rotation seconds (0: never) and the
+//           tickets of the 2 previous keys are still accepted (and renewed)
+BU_API void ssl_set_session_resumption(uint32_t cache_size, uint32_t session_timeout, bool tickets, uint32_t ticket_key_rotation);
+
+// Build a new context through the ssl handler (certificate, key, DH) and use it for the new handshakes, the opened
+// connections keep the former one until they close. Returns false if the server doesn't run with ssl or if the new
+// certificate can't be loaded (the current context is kept).
+BU_API bool reload_ssl_context(void);
+
+// The security profiles, it must be called before run_server:
+//  SSL_PROFILE_LEGACY:         TLS 1.2 only, the ciphers of OpenSSL and the DH parameters of the ssl handler (the default)
+//  SSL_PROFILE_INTERMEDIATE:   TLS 1.3 and 1.2, ECDHE key exchange with AEAD ciphers
+//  SSL_PROFILE_MODERN:         TLS 1.3 only
+// A null or empty list keeps the default of the profile:
+//  curves: the key exchange groups by preference, e.g. "X25519:P-256"
+//  ciphers: the TLS 1.2 cipher list, ciphersuites: the TLS 1.3 cipher suites
+//  dh: load the DH parameters to allow the DHE ciphers, they are slower than ECDHE
+enum { SSL_PROFILE_LEGACY = 0, SSL_PROFILE_INTERMEDIATE, SSL_PROFILE_MODERN };
+BU_API void ssl_set_profile(int profile, const char* curves, const char* ciphers, const char* ciphersuites, bool prefer_server_ciphers, bool dh);
+
+// The TLS handshakes and their connections, it must be called before run_server:
+//  threads: the TLS connections are moved to a dedicated pool of threads, so that a burst of full handshakes doesn't
+//           stall the plain connections (0: they run on the io threads)
+//  max_concurrent_handshakes: the other handshakes wait for their turn in arrival order (0: unlimited), reported by
+//           get_server_counters(ssl_handshakes_queued, ssl_handshakes_waiting, ssl_handshake_wait_nanoseconds)
+BU_API void ssl_set_handshake_pool(uint32_t threads, uint32_t max_concurrent_handshakes);
+// The handshakes waiting for the limit of ssl_set_handshake_pool, it must be called before run_server:
+//  max_waiting: the connections over it are closed at once (0: unlimited, 1024 by default)
+//  wait_timeout_milliseconds: the connections which waited longer are closed (0: unlimited, 10 s by default)
+// They are reported by get_server_counters(ssl_handshakes_refused).
+BU_API void ssl_set_handshake_queue(uint32_t max_waiting, uint32_t wait_timeout_milliseconds);
+
+// Run full handshakes in memory with a profile (and the configured lists) and return the handshakes per second of the server side.
+// The certificate handlers are called on the calling thread.
+BU_API double ssl_benchmark_handshakes(int profile, bool dh, uint32_t handshake_count);
+
+// Measure the session plumbing, the type-erased path of the former sessions against the static one of the handler policies:
+//  SESSION_DISPATCH_SHARED_FROM_THIS: the typed pointer of a session, taken by every async operation
+//  SESSION_DISPATCH_HTTP_HANDLERS: the handler calls of a request (body limit, timeout, request and its response handle)
+//  SESSION_DISPATCH_WS_LOOKUP: the lookup of a connection by ws_connection_send
+// Returns the nanoseconds per operation. It must not run with the server. See bin/benchmark_session_dispatch.py.
+enum { SESSION_DISPATCH_SHARED_FROM_THIS = 0, SESSION_DISPATCH_HTTP_HANDLERS, SESSION_DISPATCH_WS_LOOKUP };
+BU_API double session_benchmark_dispatch(int operation, bool type_erased, uint32_t iterations);
+
 //////////////////////////////////////// http handles ////////////////////////////////////////
 
 // The http handler is called after an HTTP request is received.
@@ -77,18 +214,92 @@ BU_API void set_http_handler(http_handler_type handle_cb, uintptr_t user_data);
 typedef uint32_t(*http_timeout_handler_type)(uintptr_t user_data, uintptr_t session_handle);
 BU_API void set_http_timeout_handler(http_timeout_handler_type handle_cb, uintptr_t user_data);
 
+// The timeouts (seconds) of the phases of a request, they must be set before run_server. 0 keeps the timeout handler's,
+// which then bounds the whole request as long as none of the read phases is set.
+//  idle: waiting for the next request of a keep-alive connection
+//  header: receiving the header, also the TLS detection and handshake of a new connection
+//  body: receiving the body
+//  write: sending a response
+BU_API void set_http_timeouts(uint32_t idle, uint32_t header, uint32_t body, uint32_t write);
+// The min rates (bytes per second, 0: none) of the slow clients: the deadline of the header, the body and a response
+// is extended by 1 s per min rate bytes, a client which sends or reads slower is dropped. A min read rate alone applies
+// the timeout handler's to each phase.
+BU_API void set_http_min_rates(uint32_t read_bytes_per_second, uint32_t write_bytes_per_second);
+// The cap of the keep-alive connections waiting for their next request (0: unlimited), the oldest one is closed to
+// make room for a new one. The idle connections are expired in bulk by a timer wheel per io_context.
+BU_API void set_http_max_idle_connections(uint32_t max_idle_connections);
+
 // The body limit handler is called when an HTTP request is be receiving.
 typedef uint32_t(*http_body_limit_handler_type)(uintptr_t user_data, uintptr_t session_handle);
 BU_API void set_http_body_limit_handler(http_body_limit_handler_type handle_cb, uintptr_t user_data);
 
 //////////////////////////////////////// ws handles ////////////////////////////////////////
 
-BU_API void ws_connection_send(uintptr_t connection, const char* message);
+// Returns false if the connection is closed (a stale handle is detected safely).
+BU_API bool ws_connection_send(uintptr_t connection, const char* message);
+BU_API bool ws_connection_exists(uintptr_t connection);
+BU_API uint32_t ws_connection_count(void);
+
+// Per-connection attributes(key/value). Set an empty or null value to remove the attribute.
+BU_API bool ws_connection_set_attribute(uintptr_t connection, const char* key, const char* value);
+// Copy the attribute into the buffer and return its full size, or -1 if the connection or the attribute doesn't exist.
+BU_API int32_t ws_connection_get_attribute(uintptr_t connection, const char* key, char* buffer, uint32_t buffer_size);
+
+// Length-aware messages: the opcode is WS_OPCODE_TEXT or WS_OPCODE_BINARY.
+enum { WS_OPCODE_TEXT = 1, WS_OPCODE_BINARY = 2 };
+BU_API bool ws_connection_send_data(uintptr_t connection, const char* data, uint32_t data_size, int opcode);
+
+// The outbound queue of a connection. When the queued bytes reach the high-water mark (0: unlimited), the policy is:
+//  WS_QUEUE_DROP_OLDEST:   drop the oldest unsent messages
+//  WS_QUEUE_CLOSE:         close the slow consumer
+//  WS_QUEUE_CONFLATE:      replace the unsent message with the same key (see ws_connection_send_keyed), or drop the oldest
+enum { WS_QUEUE_DROP_OLDEST = 0, WS_QUEUE_CLOSE, WS_QUEUE_CONFLATE };
+BU_API void ws_set_write_queue_limit(uint32_t high_water_bytes, int overflow_policy);
+BU_API bool ws_connection_send_keyed(uintptr_t connection, const char* key, const char* message);
+// Returns the bytes queued (including the message being written) or -1 if the connection is closed.
+BU_API int64_t ws_connection_queued_bytes(uintptr_t connection);
+// Returns an estimate of the memory held by a connection (the session, its read buffer, its outbound queue and its
+// zlib state) or -1 if the connection is closed.
+BU_API int64_t ws_connection_memory(uintptr_t connection);
+
+// permessage-deflate, it is negotiated with the clients which offer it. It must be called before run_server.
+//  window_bits(9~15) and mem_level(1~9): the memory held by every connection, about 5 * 2^window_bits + 2^(mem_level+9) bytes
+//  comp_level(0~9): the CPU spent against the ratio
+//  no_context_takeover: release the window after each message, it saves memory but worsens the ratio of small messages
+//  min_size: the messages below it are sent uncompressed (requires Boost 1.76 or later)
+// The ratio and the CPU time are estimated by sampling, see get_server_counters.
+BU_API void ws_set_permessage_deflate(bool enable, int window_bits, int mem_level, int comp_level, bool no_context_takeover, uint32_t min_size);
+
+// Topics: a broadcast to a topic is sent to its subscribers. The payload is copied once and shared by all the
+// recipients, which receive the broadcasts of a thread in order. A null or empty topic means all the
+// connections. Returns the count of the recipients.
+BU_API bool ws_subscribe(uintptr_t connection, const char* topic);
+BU_API bool ws_unsubscribe(uintptr_t connection, const char* topic);
+BU_API uint32_t ws_broadcast(const char* topic, const char* data, uint32_t data_size, uintptr_t exclude_connection);
+BU_API uint32_t ws_broadcast_data(const char* topic, const char* data, uint32_t data_size, int opcode, uintptr_t exclude_connection);
+
+// Visit the opened connections. Return true from the callback to stop.
+typedef bool (*ws_connection_visit_cb_type)(uintptr_t user_data, uintptr_t connection);
+BU_API void ws_connections_visit(ws_connection_visit_cb_type visit_cb, uintptr_t user_data);
 
 // The message handler is called after a new message has been received.
 typedef void (*ws_message_handler_type)(uintptr_t user_data, uintptr_t session_handle, const char* message_content);
 BU_API void ws_set_message_handler(ws_message_handler_type handle_cb, uintptr_t user_data);
 
+// The data message handler is length-aware and gets the opcode, it takes the place of the message handler.
+// The data points into the receive buffer of the connection and is valid during the call only.
+typedef void (*ws_data_message_handler_type)(uintptr_t user_data, uintptr_t session_handle, const char* data, uint32_t data_size, int opcode);
+BU_API void ws_set_data_message_handler(ws_data_message_handler_type handle_cb, uintptr_t user_data);
+
+// The max size of an inbound message(16MB by default), 0 means unlimited. A larger message closes the connection with 1009.
+BU_API void ws_set_read_message_max(uint64_t max_bytes);
+
+// The chunk handler streams the inbound messages frame by frame instead of receiving them whole, it takes the place of
+// the message handlers (and of the async bridge). A chunk is at most chunk_size bytes, is_final is set on the last chunk
+// of a message. The data is valid during the call only. A null handler restores the whole messages.
+typedef void (*ws_chunk_handler_type)(uintptr_t user_data, uintptr_t session_handle, const char* data, uint32_t data_size, int opcode, bool is_final);
+BU_API void ws_set_chunk_handler(ws_chunk_handler_type handle_cb, uintptr_t user_data, uint32_t chunk_size);
+
 // The open handler is called after the WebSocket handshake is complete and the connection is considered OPEN.
 typedef void (*ws_open_handler_type)(uintptr_t user_data, uintptr_t session_handle);
 BU_API void ws_set_open_handler(ws_open_handler_type handle_cb, uintptr_t user_data);
@@ -97,4 +308,33 @@ BU_API void ws_set_open_handler(ws_open_handler_type handle_cb, uintptr_t user_d
 typedef void (*ws_close_handler_type)(uintptr_t user_data, uintptr_t session_handle);
 BU_API void ws_set_close_handler(ws_close_handler_type handle_cb, uintptr_t user_data);
 
+//////////////////////////////////////// async bridge ////////////////////////////////////////
+
+// The async bridge queues HTTP requests and WebSocket events for a foreign event loop (e.g. python asyncio)
+// instead of calling the handlers above on the io threads.
+enum { ASYNC_EVENT_HTTP_REQUEST = 1, ASYNC_EVENT_WS_OPEN, ASYNC_EVENT_WS_MESSAGE, ASYNC_EVENT_WS_CLOSE, ASYNC_EVENT_WS_BINARY_MESSAGE };
+
+// Enable the bridge. Returns an event descriptor which becomes readable when events are queued, or -1 if the
+// platform has none: the wakeup handler (optional) is called from an io thread instead.
+typedef void (*async_bridge_wakeup_handler_type)(uintptr_t user_data);
+BU_API int async_bridge_enable(async_bridge_wakeup_handler_type wakeup_cb, uintptr_t user_data);
+BU_API void async_bridge_disable(void);
+
+// Drain at most max_events (0: all) queued events on the calling thread. The handle is the request handle for
+// ASYNC_EVENT_HTTP_REQUEST and the connection handle for the ws events. The contents are valid during the call only.
+typedef void (*async_event_handler_type)(uintptr_t user_data, int event_type, uintptr_t handle, const char* head, uint32_t head_size,
+    const char* body, uint32_t body_size);
+BU_API uint32_t async_bridge_poll(async_event_handler_type handle_cb, uintptr_t user_data, uint32_t max_events);
+
+// The CoDel control of the queued HTTP requests, a target of 0 (the default) disables it. When the requests wait
+// longer than target_milliseconds in the queue for interval_milliseconds, the queue is overloaded until a request
+// waits less: the requests queued for more than an interval get a 503 (Retry-After: 1), then the newest requests
+// are dispatched first (CODEL_POLICY_LIFO) or the new ones get a 503 at once (CODEL_POLICY_SHED).
+// The wait is reported by get_server_counters(dispatch_xxx).
+enum { CODEL_POLICY_LIFO = 0, CODEL_POLICY_SHED };
+BU_API void async_bridge_set_codel(uint32_t target_milliseconds, uint32_t interval_milliseconds, int policy);
+
+// Answer a queued HTTP request. It is thread-safe and returns false if the request handle is unknown.
+BU_API bool async_http_respond(uintptr_t request_handle, const char* response_content, uint32_t response_size);
+
 #endif  // INCLUDE_BEAST_UTILS_H_
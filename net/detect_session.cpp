@@ -8,8 +8,12 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/asio/dispatch.hpp>
 #include "net/net_utils.h"
+#include "src/io_context_pool.h"
+#include "src/server_options.h"
 
-detect_session::detect_session(socket_type&& socket, handle_type handle) : stream_(std::move(socket)), handle_(handle), INSTANCE_LOG_IMPL {
+detect_session::detect_session(socket_type&& socket, handle_type handle, admission_ticket_type admission_ticket) : stream_(std::move(socket)),
+                               handle_(handle), load_ticket_(make_io_load_ticket(stream_.get_executor())),
+                               admission_ticket_(std::move(admission_ticket)), INSTANCE_LOG_IMPL {
 }
 
 detect_session::~detect_session(void) {
@@ -20,14 +24,16 @@ void detect_session::run(void) {
     // on the I/O objects in this session. Although not strictly necessary
     // for single-threaded contexts, this example code is written to be
     // thread-safe by default.
-    boost::asio::dispatch(stream_.get_executor(), boost::beast::bind_front_handler(&detect_session::on_run, this->shared_from_this()));
+    boost::asio::dispatch(stream_.get_executor(), make_arena_handler(handler_arena_, boost::beast::bind_front_handler(&detect_session::on_run,
+                          this->shared_from_this())));
 }
 
 void detect_session::on_run(void) {
-    // Set the timeout.
-    stream_.expires_after(std::chrono::seconds(30));
-    boost::beast::async_detect_ssl(stream_, buffer_, boost::beast::bind_front_handler(&detect_session::on_detect,
-        this->shared_from_this()));
+    // Set the timeout, the first bytes are a part of the header
+    const auto header_timeout = server_options_get_instance()->http_header_timeout;
+    stream_.expires_after(std::chrono::seconds(header_timeout ? header_timeout : 30));
+    boost::beast::async_detect_ssl(stream_, buffer_, make_arena_handler(handler_arena_, boost::beast::bind_front_handler(&detect_session::on_detect,
+        this->shared_from_this())));
 }
 
 void detect_session::on_detect(error_code_type ec, bool result) {
@@ -37,6 +43,6 @@ void detect_session::on_detect(error_code_type ec, bool result) {
         LOG(VERBOSE) << "detect_session.detected(" << boost::lexical_cast<std::string>(stream_.socket().remote_endpoint()) << " ==> "
             << boost::lexical_cast<std::string>(stream_.socket().local_endpoint()) << "): " << (result ? "SSL http" : "plain http");
 
-        handle_(result, std::move(stream_), std::move(buffer_));
+        handle_(result, std::move(stream_), std::move(buffer_), std::move(admission_ticket_));
     }
 }
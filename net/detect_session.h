@@ -7,6 +7,8 @@
 
 #include <boost/beast/core.hpp>
 #include "base/utils.h"
+#include "src/handler_arena.h"
+#include "src/session_pool.h"
 
 //////////////////////////////////////// declarations ////////////////////////////////////////
 
@@ -14,13 +16,15 @@ class detect_session : public std::enable_shared_from_this<detect_session> {
  public:
     typedef detect_session                                      this_type;
     typedef boost::beast::tcp_stream                            tcp_stream_type;
-    typedef boost::beast::flat_buffer                           flat_buffer_type;
+    typedef session_buffer_type                                 flat_buffer_type;
     typedef boost::asio::ip::tcp::socket                        socket_type;
     typedef boost::beast::error_code                            error_code_type;
-    typedef std::function<void(bool ssl, boost::beast::tcp_stream&& stream, boost::beast::flat_buffer&& buffer)> handle_type;
+    typedef std::shared_ptr<void>                               admission_ticket_type;
+    typedef std::function<void(bool ssl, boost::beast::tcp_stream&& stream, flat_buffer_type&& buffer,
+                               admission_ticket_type admission_ticket)> handle_type;
 
  public:
-     detect_session(socket_type&& socket, handle_type handle);
+     detect_session(socket_type&& socket, handle_type handle, admission_ticket_type admission_ticket);
      ~detect_session(void);
      explicit detect_session(const this_type&) = delete;
      this_type& operator=(const this_type&) = delete;
@@ -36,6 +40,11 @@ class detect_session : public std::enable_shared_from_this<detect_session> {
     tcp_stream_type             stream_;
     flat_buffer_type            buffer_;
     handle_type                 handle_;
+    // Counts the connection in the load of its io_context
+    std::shared_ptr<void>       load_ticket_;
+    // Handed over to the http session
+    admission_ticket_type       admission_ticket_;
+    handler_arena               handler_arena_;
     INSTANCE_LOG_DECLARE;
 };
 
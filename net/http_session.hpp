@@ -11,6 +11,8 @@
 #include <vector>
 #include <iostream>
 #include <thread>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/websocket.hpp>
@@ -19,19 +21,59 @@
 #include "net/websocket_session_factory.hpp"
 #include "net/net_utils.h"
 #include "base/utils.h"
+#include "src/connection_reaper.h"
+#include "src/handler_arena.h"
+#include "src/rate_limiter.h"
+#include "src/server_counters.h"
+#include "src/server_options.h"
+#include "src/session_pool.h"
+
+//
+// The handlers of the requests are a policy of the session, a class with these members:
+//
+//      uint32_t body_limit(object_pointer_type session)
+//      uint32_t timeout_seconds(object_pointer_type session)
+//      void request(object_pointer_type session, const char* head, const char* body, uint32_t body_size, response_handle_type response_cb)
+//
+// The library's handlers are bound at compile time (scaffold_http_handlers), function_http_handlers takes any others at run time.
+//
+struct function_http_handlers {
+    typedef std::shared_ptr<virtual_enable_shared_from_this_base>                                   object_pointer_type;
+    typedef std::function<uint32_t(object_pointer_type)>                                            limit_handle_type;
+    typedef std::function<uint32_t(object_pointer_type)>                                            timeout_handle_type;
+    typedef std::function<void(uintptr_t, const char*, uint32_t)>                                   response_handle_type;
+    typedef std::function<void(object_pointer_type, const char*, const char*, uint32_t, response_handle_type response_cb)>  request_handle_type;
+
+    uint32_t body_limit(object_pointer_type session) { return limit_handle(std::move(session)); }
+    uint32_t timeout_seconds(object_pointer_type session) { return timeout_handle(std::move(session)); }
+    void request(object_pointer_type session, const char* head, const char* body, uint32_t body_size, response_handle_type response_cb) {
+        request_handle(std::move(session), head, body, body_size, std::move(response_cb));
+    }
+
+    limit_handle_type                           limit_handle;
+    timeout_handle_type                         timeout_handle;
+    request_handle_type                         request_handle;
+};
 
-template<class Derived>
+template<class Derived, class Handlers>
 class http_session : virtual public virtual_enable_shared_from_this_base {
  public:
     typedef Derived                                                                                 derived_type;
-    typedef http_session<derived_type>                                                              this_type;
-    typedef boost::beast::flat_buffer                                                               flat_buffer_type;
-    typedef boost::optional<boost::beast::http::request_parser<boost::beast::http::string_body>>    parser_type;
+    typedef Handlers                                                                                handlers_type;
+    typedef http_session<derived_type, handlers_type>                                               this_type;
+    typedef session_buffer_type                                                                     flat_buffer_type;
+    // The fields of the request are allocated by the session pool
+    typedef boost::optional<boost::beast::http::request_parser<boost::beast::http::string_body, session_allocator<char>>> parser_type;
     typedef std::shared_ptr<virtual_enable_shared_from_this_base>                                   object_pointer_type;
-    typedef std::function<uint32_t(object_pointer_type)>                                            limit_handle_type;
-    typedef std::function<uint32_t(object_pointer_type)>                                            timeout_handle_type;
     typedef std::function<void(uintptr_t, const char*, uint32_t)>                                   response_handle_type;
-    typedef std::function<void(object_pointer_type, const char*, const char*, uint32_t, response_handle_type response_cb)>  request_handle_type;
+    typedef std::chrono::steady_clock                                                               clock_type;
+
+    // The phases of a request read, each has its own deadline
+    enum read_phase { read_idle, read_header, read_body };
+    // Why the reaper closed an idle connection
+    enum idle_expiry { idle_expiry_none, idle_expiry_timeout, idle_expiry_evicted };
+    // A larger buffer is released after the request, any in the low-memory mode
+    enum { idle_read_size = 4096, retained_buffer_size = 64 * 1024 };
     // This queue is used for HTTP pipelining.
     class queue {
         enum{limit = 8};  // Maximum number of responses we will queue
@@ -56,6 +98,10 @@ class http_session : virtual public virtual_enable_shared_from_this_base {
             return items_.size() >= limit;
         }
 
+        bool is_empty(void) const {
+            return items_.empty();
+        }
+
         // Called when a message finishes sending
         // Returns `true` if the caller should initiate a read
         bool on_write(void) {
@@ -76,8 +122,9 @@ class http_session : virtual public virtual_enable_shared_from_this_base {
                 boost::beast::http::message<isRequest, Body, Fields> msg_;
                 work_impl(http_session& self, boost::beast::http::message<isRequest, Body, Fields>&& msg) : self_(self), msg_(std::move(msg)) {}
                 void operator()() {
-                    boost::beast::http::async_write(self_.derived().stream(), msg_, boost::beast::bind_front_handler(&http_session::on_write,
-                                                    self_.derived().shared_from_this(), msg_.need_eof()));
+                    self_.set_write_deadline(msg_.payload_size() ? *msg_.payload_size() : 0);
+                    boost::beast::http::async_write(self_.derived().stream(), msg_, self_.bind_arena(boost::beast::bind_front_handler(
+                                                    &http_session::on_write, self_.derived().shared_from_this(), msg_.need_eof())));
                 }
             };
 
@@ -91,29 +138,194 @@ class http_session : virtual public virtual_enable_shared_from_this_base {
     };
 
  public:
-    http_session(flat_buffer_type buffer, limit_handle_type limit_handle, timeout_handle_type timeout_handle, request_handle_type request_handle):
-        queue_(*this), buffer_(std::move(buffer)), limit_handle_(limit_handle), timeout_handle_(timeout_handle), request_handle_(request_handle),
-        INSTANCE_LOG_IMPL {}
-    ~http_session(void) {}
+    explicit http_session(flat_buffer_type buffer, handlers_type handlers = handlers_type()):
+        queue_(*this), handlers_(std::move(handlers)), pending_responses_(0), read_deferred_(false), read_phases_(false), idle_timeout_(server_options_get_instance()->http_idle_timeout),
+        header_timeout_(server_options_get_instance()->http_header_timeout), body_timeout_(server_options_get_instance()->http_body_timeout),
+        write_timeout_(server_options_get_instance()->http_write_timeout), min_read_rate_(server_options_get_instance()->http_min_read_rate),
+        min_write_rate_(server_options_get_instance()->http_min_write_rate), read_phase_(read_idle), read_phase_bytes_(0),
+        idle_expiry_(idle_expiry_none), low_memory_(server_options_get_instance()->low_memory), buffer_bytes_(0), INSTANCE_LOG_IMPL,
+        buffer_(std::move(buffer)) {
+        read_phases_ = server_options_get_instance()->http_read_phases();
+        if (server_options_get_instance()->connection_buffer_max)
+            buffer_.max_size(std::max<std::size_t>(buffer_.size(), server_options_get_instance()->connection_buffer_max));
+        account_session_buffer(&buffer_bytes_, buffer_.capacity());
+    }
+    ~http_session(void) {
+        if (idle_connection_)
+            connection_reaper_get_instance()->disarm(*idle_connection_);
+        account_session_buffer(&buffer_bytes_, 0);
+    }
 
  public:
     derived_type& derived(void) { return static_cast<derived_type&>(*this);}
+    // Counts the connection in the admission control, it's handed over to the websocket session
+    void set_admission_ticket(std::shared_ptr<void> admission_ticket) { admission_ticket_ = admission_ticket; }
 
  protected:
+    // The async operations of the session are allocated by its arena
+    template<class Handler>
+    arena_handler<typename std::decay<Handler>::type> bind_arena(Handler&& handler) {
+        return make_arena_handler(handler_arena_, std::forward<Handler>(handler));
+    }
+
     void do_read(void) {
         // Construct a new parser for each message
         parser_.emplace();
 
         // Apply a reasonable limit to the allowed size
         // of the body in bytes to prevent abuse.
-        parser_->body_limit(limit_handle_(object_pointer_from(this)));
+        parser_->body_limit(handlers_.body_limit(shared_from_this()));
+
+        // Without the timeouts of the phases, the timeout applies to the whole read
+        request_timeout_ = std::chrono::seconds(handlers_.timeout_seconds(shared_from_this()));
+        if (!read_phases_) {
+            // Set the timeout.
+            boost::beast::get_lowest_layer(derived().stream()).expires_after(request_timeout_);
+
+            // Read a request using the parser-oriented interface
+            return boost::beast::http::async_read(derived().stream(), buffer_, *parser_, bind_arena(boost::beast::bind_front_handler(
+                                                  &http_session::on_read, derived().shared_from_this())));
+        }
+
+        // The bytes of a pipelined request are already buffered
+        start_read_phase(buffer_.size() ? read_header : read_idle);
+        do_read_some();
+    }
+
+    void start_read_phase(read_phase phase) {
+        read_phase_ = phase;
+        read_phase_start_ = clock_type::now();
+        read_phase_bytes_ = 0;
+    }
 
-        // Set the timeout.
-        boost::beast::get_lowest_layer(derived().stream()).expires_after(std::chrono::seconds(timeout_handle_(shared_from_this())));
+    void do_read_some(void) {
+        // A trickling client is dropped: the deadline of the body is extended by 1 s per min_read_rate bytes received
+        auto timeout = read_phase_ == read_idle ? idle_timeout_ : (read_phase_ == read_header ? header_timeout_ : body_timeout_);
+        auto deadline = read_phase_start_ + (timeout.count() ? timeout : request_timeout_);
+        if (min_read_rate_ && read_phase_ != read_idle)
+            deadline += std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(static_cast<double>(read_phase_bytes_) / min_read_rate_));
+
+        // The idle phase ends with the first bytes, the parser returns once the header is whole. The idle connection
+        // is watched by the timer wheel of its io_context rather than by the timer of its stream.
+        const bool reaped = read_phase_ == read_idle && arm_idle(timeout.count() ? timeout : request_timeout_);
+        if (reaped)
+            boost::beast::get_lowest_layer(derived().stream()).expires_never();
+        else
+            boost::beast::get_lowest_layer(derived().stream()).expires_at(deadline);
+        if (reaped && low_memory_ && async_wait_readable(derived().stream(),
+                bind_arena(boost::beast::bind_front_handler(&http_session::on_wait_idle, derived().shared_from_this()))))
+            return;
+        if (read_phase_ == read_idle)
+            return derived().stream().async_read_some(buffer_.prepare(std::min<std::size_t>(idle_read_size, buffer_.max_size() - buffer_.size())),
+                                                      bind_arena(boost::beast::bind_front_handler(&http_session::on_read_idle,
+                                                                                                  derived().shared_from_this())));
+        boost::beast::http::async_read_some(derived().stream(), buffer_, *parser_, bind_arena(boost::beast::bind_front_handler(
+                                            &http_session::on_read_some, derived().shared_from_this())));
+    }
+
+    // In the low-memory mode, an idle plain connection waits for its socket to be readable without a buffer. The TLS
+    // streams read as usual: the engine may hold the bytes of the next record already.
+    template<class Protocol, class Executor, class RatePolicy, class Handler>
+    static bool async_wait_readable(boost::beast::basic_stream<Protocol, Executor, RatePolicy>& stream, Handler&& handler) {
+        stream.socket().async_wait(boost::asio::socket_base::wait_read, std::forward<Handler>(handler));
+        return true;
+    }
+    template<class Stream, class Handler>
+    static bool async_wait_readable(Stream&, Handler&&) {
+        return false;
+    }
 
-        // Read a request using the parser-oriented interface
-        boost::beast::http::async_read(derived().stream(), buffer_, *parser_, boost::beast::bind_front_handler(&http_session::on_read,
-                                       derived().shared_from_this()));
+    void on_wait_idle(boost::beast::error_code ec) {
+        on_read_idle(ec, 0);
+    }
+
+    void on_read_idle(boost::beast::error_code ec, std::size_t bytes_transferred) {
+        if (idle_connection_)
+            connection_reaper_get_instance()->disarm(*idle_connection_);
+        buffer_.commit(bytes_transferred);
+        // Closed by the reaper: a timeout is reported as the one of the stream, an evicted connection ends quietly
+        if (idle_expiry_ == idle_expiry_evicted)
+            return;
+        if (idle_expiry_ == idle_expiry_timeout)
+            return on_read(boost::beast::error::timeout, 0);
+        if (ec == boost::asio::error::eof)
+            return on_read(boost::beast::http::error::end_of_stream, 0);
+        if (ec)
+            return on_read(ec, 0);
+
+        start_read_phase(read_header);
+        do_read_some();
+    }
+
+    void on_read_some(boost::beast::error_code ec, std::size_t bytes_transferred) {
+        if (ec || parser_->is_done()) {
+            // The handler and the response aren't bound by the deadline of the read
+            if (!ec)
+                boost::beast::get_lowest_layer(derived().stream()).expires_after(request_timeout_);
+            return on_read(ec, bytes_transferred);
+        }
+
+        if (read_phase_ == read_header)
+            start_read_phase(read_body);
+        else
+            read_phase_bytes_ += bytes_transferred;
+        do_read_some();
+    }
+
+    bool arm_idle(std::chrono::seconds timeout) {
+        if (!idle_connection_) {
+            auto executor = derived().stream().get_executor();
+            std::weak_ptr<derived_type> weak_self = derived().shared_from_this();
+            idle_connection_ = make_idle_connection(executor, [executor, weak_self](uint64_t generation, bool evicted) {
+                boost::asio::post(executor, [weak_self, generation, evicted]() {
+                    if (auto self = weak_self.lock())
+                        self->expire_idle(generation, evicted);
+                });
+            });
+            if (!idle_connection_)
+                return false;
+        }
+        connection_reaper_get_instance()->arm(idle_connection_, timeout);
+        return true;
+    }
+
+    // The connection may have been busy again since the reaper picked it: an older generation is ignored
+    void expire_idle(uint64_t generation, bool evicted) {
+        if (!idle_connection_ || idle_connection_->generation.load(std::memory_order_relaxed) != generation)
+            return;
+        idle_expiry_ = evicted ? idle_expiry_evicted : idle_expiry_timeout;
+        boost::beast::get_lowest_layer(derived().stream()).close();
+    }
+
+    // Don't hold the memory of a large header (of any header in the low-memory mode) until the next request
+    void trim_buffer(void) {
+        if (!buffer_.size() && buffer_.capacity() > (low_memory_ ? 0 : static_cast<std::size_t>(retained_buffer_size)))
+            buffer_.shrink_to_fit();
+        account_session_buffer(&buffer_bytes_, buffer_.capacity());
+    }
+
+    // The next request is read once the responses are answered, and once they are written with the read phases:
+    // the idle timeout doesn't run while a response is sent
+    bool read_blocked(void) const {
+        return pending_responses_ > 0 || (read_phases_ && !queue_.is_empty());
+    }
+
+    void resume_read(void) {
+        if (read_deferred_ && !read_blocked()) {
+            read_deferred_ = false;
+            if (!queue_.is_full())
+                do_read();
+        }
+    }
+
+    // The response has to be consumed at min_write_rate at least
+    void set_write_deadline(uint64_t response_size) {
+        if (!write_timeout_.count() && !min_write_rate_)
+            return;
+        auto timeout = std::chrono::duration_cast<clock_type::duration>(write_timeout_.count() ? write_timeout_ : request_timeout_);
+        if (min_write_rate_)
+            timeout += std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(static_cast<double>(response_size) / min_write_rate_));
+        boost::beast::get_lowest_layer(derived().stream()).expires_after(timeout);
     }
 
     void on_read(boost::beast::error_code ec, std::size_t bytes_transferred) {
@@ -123,22 +335,34 @@ class http_session : virtual public virtual_enable_shared_from_this_base {
         if (ec == boost::beast::http::error::end_of_stream)
             return derived().do_eof();
 
+        if (ec == boost::beast::error::timeout)
+            server_counters_get_instance()->add(server_counters::http_read_timeouts);
         if (ec)
             return handle_error(ec, "http_session.read");
+        trim_buffer();
+        server_counters_get_instance()->add(server_counters::http_requests);
+
+        // Over its rate limit, the request is answered natively: it doesn't reach the handler. An upgrade is charged like
+        // a request, a refused one doesn't open a WebSocket session.
+        uint32_t retry_after_seconds = 0;
+        const bool admitted = rate_limit_admit(parser_->get(), &retry_after_seconds);
 
         // See if it is a WebSocket Upgrade
-        if (boost::beast::websocket::is_upgrade(parser_->get())) {
+        if (admitted && boost::beast::websocket::is_upgrade(parser_->get())) {
             // Disable the timeout.
             // The websocket::stream uses its own timeout settings.
             boost::beast::get_lowest_layer(derived().stream()).expires_never();
 
             // Create a websocket session, transferring ownership
             // of both the socket and the HTTP request.
-            return make_websocket_session(derived().release_stream(), parser_->release());
+            return make_websocket_session(derived().release_stream(), parser_->release(), std::move(admission_ticket_));
         }
 
-        // Send the response
-        {
+        if (!admitted) {
+            ++pending_responses_;
+            write_response(rate_limited_response(retry_after_seconds));
+        } else {
+            // Send the response
             static const char* kCrLF = "\r\n";
             static const char* kDblCrLF = "\r\n\r\n";
             enum{prpDblCrLfSize = 4};
@@ -149,8 +373,16 @@ class http_session : virtual public virtual_enable_shared_from_this_base {
             std::string request_content = ss.str();
             std::string body_content = req.body();
             request_content = request_content.substr(0, request_content.find(kDblCrLF) + prpDblCrLfSize);
-            request_handle_(shared_from_this(), request_content.c_str(), body_content.c_str(), static_cast<unsigned int>(body_content.size()),
-                std::bind(&this_type::response_cb, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            ++pending_responses_;
+            handlers_.request(shared_from_this(), request_content.c_str(), body_content.c_str(), static_cast<unsigned int>(body_content.size()),
+                              response_handle());
+        }
+
+        // The handler answers later (async bridge): responses have to keep the request order,
+        // so the next request is read after this one has been answered.
+        if (read_blocked()) {
+            read_deferred_ = true;
+            return;
         }
 
         // If we aren't at the queue limit, try to pipeline another request
@@ -161,6 +393,8 @@ class http_session : virtual public virtual_enable_shared_from_this_base {
     void on_write(bool close, boost::beast::error_code ec, std::size_t bytes_transferred) {
         boost::ignore_unused(bytes_transferred);
 
+        if (ec == boost::beast::error::timeout)
+            server_counters_get_instance()->add(server_counters::http_write_timeouts);
         if (ec)
             return handle_error(ec, "http_session.write");
 
@@ -174,17 +408,59 @@ class http_session : virtual public virtual_enable_shared_from_this_base {
         if (queue_.on_write()) {
             // Read another request
             do_read();
+        } else {
+            resume_read();
         }
     }
 
+    // The handle holds the session until it's dropped, an answer given after the session is closed is discarded
+    response_handle_type response_handle(void) {
+        return [self = derived().shared_from_this()](uintptr_t server_data, const char* response_content, uint32_t response_size) {
+            self->response_cb(server_data, response_content, response_size);
+        };
+    }
+
+    // It may be called from any thread: the response is copied and written on the session's strand.
     void response_cb(uintptr_t server_data, const char* response_content, unsigned int response_size) {
         LOG(VERBOSE) << "http_session::response_cb(" << boost::lexical_cast<std::string>(std::this_thread::get_id()) << ") called.";
 
+        auto sp_content = std::make_shared<std::string>(response_content, response_content + response_size);
+        boost::asio::dispatch(derived().stream().get_executor(), bind_arena([this, self = derived().shared_from_this(), sp_content]() {
+            write_response(*sp_content);
+        }));
+    }
+
+    template<class Request>
+    bool rate_limit_admit(const Request& req, uint32_t* retry_after_seconds) {
+        auto limiter = rate_limiter_get_instance();
+        if (!limiter->enabled())
+            return true;
+
+        if (client_address_.empty())
+            client_address_ = remote_address(boost::beast::get_lowest_layer(derived().stream()).socket());
+        const auto& key_header = limiter->key_header();
+        auto it = key_header.empty() ? req.end() : req.find(key_header);
+        if (limiter->admit(req.target(), client_address_, it != req.end() ? it->value() : boost::beast::string_view(), retry_after_seconds))
+            return true;
+        server_counters_get_instance()->add(server_counters::rate_limited_requests);
+        return false;
+    }
+
+    static std::string rate_limited_response(uint32_t retry_after_seconds) {
+        return "HTTP/1.1 429 Too Many Requests\r\nContent-Length: 0\r\nRetry-After: " + std::to_string(std::max<uint32_t>(1, retry_after_seconds)) +
+               "\r\n\r\n";
+    }
+
+    void write_response(const std::string& response_content) {
         boost::beast::error_code ec;
         boost::beast::http::response_parser<boost::beast::http::string_body> p;
         p.eager(true);
-        p.put(boost::asio::buffer(std::string(response_content, response_content + response_size)), ec);
+        p.put(boost::asio::buffer(response_content), ec);
         (queue_)(std::move(p.release()));
+
+        if (pending_responses_ > 0)
+            --pending_responses_;
+        resume_read();
     }
 
  private:
@@ -192,9 +468,31 @@ class http_session : virtual public virtual_enable_shared_from_this_base {
     // The parser is stored in an optional container so we can
     // construct it from scratch it at the beginning of each new message.
     parser_type                                 parser_;
-    limit_handle_type                           limit_handle_;
-    timeout_handle_type                         timeout_handle_;
-    request_handle_type                         request_handle_;
+    handlers_type                               handlers_;
+    std::size_t                                 pending_responses_;
+    bool                                        read_deferred_;
+    bool                                        read_phases_;
+    std::shared_ptr<void>                       admission_ticket_;
+    // The key of the rate limiter, if the requests aren't told apart by a header
+    std::string                                 client_address_;
+    // The timeouts of the phases (0: the timeout handler's), the min rates (bytes per second, 0: none)
+    std::chrono::seconds                        idle_timeout_;
+    std::chrono::seconds                        header_timeout_;
+    std::chrono::seconds                        body_timeout_;
+    std::chrono::seconds                        write_timeout_;
+    uint32_t                                    min_read_rate_;
+    uint32_t                                    min_write_rate_;
+    std::chrono::seconds                        request_timeout_;
+    read_phase                                  read_phase_;
+    clock_type::time_point                      read_phase_start_;
+    std::size_t                                 read_phase_bytes_;
+    // The entry of the connection in the reaper, from its first idle wait
+    std::shared_ptr<connection_reaper::idle_connection>    idle_connection_;
+    idle_expiry                                 idle_expiry_;
+    bool                                        low_memory_;
+    // The capacity of buffer_ in the session_buffer_bytes counter
+    std::atomic<std::size_t>                    buffer_bytes_;
+    handler_arena                               handler_arena_;
     INSTANCE_LOG_DECLARE;
 
  protected:
@@ -4,9 +4,9 @@
 
 #include "net/http_session_plain.h"
 
-plain_http_session::plain_http_session(tcp_stream_type&& stream, flat_buffer_type&& buffer, limit_handle_type limit_handle,
-                                       timeout_handle_type timeout_handle, request_handle_type request_handle):
-                                       base_type(std::move(buffer), limit_handle, timeout_handle, request_handle), stream_(std::move(stream)) {
+plain_http_session::plain_http_session(tcp_stream_type&& stream, flat_buffer_type&& buffer):
+                                       base_type(std::move(buffer)), stream_(std::move(stream)),
+                                       load_ticket_(make_io_load_ticket(stream_.get_executor())) {
 }
 
 plain_http_session::~plain_http_session(void) {
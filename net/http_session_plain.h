@@ -7,17 +7,18 @@
 
 #include <utility>
 #include "net/http_session.hpp"
+#include "src/io_context_pool.h"
+#include "src/scaffold_handles.h"
 
-class plain_http_session : public http_session<plain_http_session>, public virtual_enable_shared_from_this<plain_http_session> {
+class plain_http_session : public http_session<plain_http_session, scaffold_http_handlers>, public virtual_enable_shared_from_this<plain_http_session> {
  public:
      typedef plain_http_session                                         this_type;
-     typedef http_session<this_type>                                    base_type;
+     typedef http_session<this_type, scaffold_http_handlers>            base_type;
     typedef boost::beast::tcp_stream                                    tcp_stream_type;
-    typedef boost::beast::flat_buffer                                   flat_buffer_type;
+    typedef session_buffer_type                                         flat_buffer_type;
 
  public:
-     plain_http_session(tcp_stream_type&& stream, flat_buffer_type&& buffer, limit_handle_type limit_handle,
-                        timeout_handle_type timeout_handle, request_handle_type request_handle);
+     plain_http_session(tcp_stream_type&& stream, flat_buffer_type&& buffer);
      ~plain_http_session(void);
     explicit plain_http_session(const this_type&) = delete;
     this_type& operator=(const this_type&) = delete;
@@ -36,6 +37,8 @@ class plain_http_session : public http_session<plain_http_session>, public virtu
 
  private:
     tcp_stream_type                        stream_;
+    // Counts the connection in the load of its io_context
+    std::shared_ptr<void>                  load_ticket_;
 };
 
 #endif  // NET_HTTP_SESSION_PLAIN_H_
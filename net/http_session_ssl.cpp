@@ -3,23 +3,29 @@
 // found in the LICENSE file.
 
 #include "net/http_session_ssl.h"
+#include "src/server_options.h"
+#include "src/ssl_session_cache.h"
 
-ssl_http_session::ssl_http_session(boost::beast::tcp_stream&& stream, ssl_context_type* ctx, flat_buffer_type&& buffer,
-                                   limit_handle_type limit_handle, timeout_handle_type timeout_handle, request_handle_type request_handle):
-                                   base_type(std::move(buffer), limit_handle, timeout_handle, request_handle), stream_(std::move(stream), *ctx) {
+ssl_http_session::ssl_http_session(boost::beast::tcp_stream&& stream, std::shared_ptr<ssl_context_type> ctx, flat_buffer_type&& buffer):
+                                   base_type(std::move(buffer)), ssl_context_(ctx),
+                                   stream_(std::move(stream), *ctx),
+                                   stream_released_(false), load_ticket_(make_io_load_ticket(stream_.get_executor())) {
 }
 
 ssl_http_session::~ssl_http_session(void) {
+    if (!stream_released_)
+        keep_ssl_session_resumable(stream_.native_handle());
 }
 
 void ssl_http_session::run(void) {
-    // Set the timeout.
-    boost::beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(30));
+    // Set the timeout, the handshake comes before the header
+    const auto header_timeout = server_options_get_instance()->http_header_timeout;
+    boost::beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(header_timeout ? header_timeout : 30));
 
     // Perform the SSL handshake
     // Note, this is the buffered version of the handshake.
     stream_.async_handshake(boost::asio::ssl::stream_base::server, base_type::buffer_.data(),
-        boost::beast::bind_front_handler(&ssl_http_session::on_handshake, this->shared_from_this()));
+        base_type::bind_arena(boost::beast::bind_front_handler(&ssl_http_session::on_handshake, this->shared_from_this())));
 }
 
 void ssl_http_session::do_eof(void) {
@@ -27,10 +33,11 @@ void ssl_http_session::do_eof(void) {
     boost::beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(30));
 
     // Perform the SSL shutdown
-    stream_.async_shutdown(boost::beast::bind_front_handler(&ssl_http_session::on_shutdown, this->shared_from_this()));
+    stream_.async_shutdown(base_type::bind_arena(boost::beast::bind_front_handler(&ssl_http_session::on_shutdown, this->shared_from_this())));
 }
 
 void ssl_http_session::on_handshake(boost::beast::error_code ec, std::size_t bytes_used) {
+    handshake_permit_.reset();
     if (ec) {
         handle_error(ec, "ssl_http_session.on_handshake");
     }
@@ -5,33 +5,37 @@
 #ifndef NET_HTTP_SESSION_SSL_H_
 #define NET_HTTP_SESSION_SSL_H_
 
+#include <memory>
 #include <utility>
 #include <boost/beast/ssl.hpp>
 #include "net/http_session.hpp"
+#include "src/io_context_pool.h"
+#include "src/scaffold_handles.h"
 
-class ssl_http_session : public http_session<ssl_http_session>, public virtual_enable_shared_from_this<ssl_http_session> {
+class ssl_http_session : public http_session<ssl_http_session, scaffold_http_handlers>, public virtual_enable_shared_from_this<ssl_http_session> {
  public:
     typedef ssl_http_session                                            this_type;
-    typedef http_session<ssl_http_session>                              base_type;
+    typedef http_session<ssl_http_session, scaffold_http_handlers>      base_type;
     typedef boost::beast::ssl_stream<boost::beast::tcp_stream>          tcp_stream_type;
     typedef boost::asio::ssl::context                                   ssl_context_type;
-    typedef boost::beast::flat_buffer                                   flat_buffer_type;
+    typedef session_buffer_type                                         flat_buffer_type;
 
  public:
-     ssl_http_session(boost::beast::tcp_stream&& stream, ssl_context_type* ctx, flat_buffer_type&& buffer, limit_handle_type limit_handle,
-                      timeout_handle_type timeout_handle, request_handle_type request_handle);
+     ssl_http_session(boost::beast::tcp_stream&& stream, std::shared_ptr<ssl_context_type> ctx, flat_buffer_type&& buffer);
      ~ssl_http_session(void);
      explicit ssl_http_session(const this_type&) = delete;
      this_type& operator=(const this_type&) = delete;
 
  public:
      void run(void);
+     // The permit of the handshake limiter, it is released once the handshake is done
+     void set_handshake_permit(std::shared_ptr<void> permit) { handshake_permit_ = permit; }
 
     // Called by the base class
     tcp_stream_type& stream(void) { return stream_; }
 
     // Called by the base class
-    tcp_stream_type release_stream(void) { return std::move(stream_); }
+    tcp_stream_type release_stream(void) { stream_released_ = true; return std::move(stream_); }
 
     // Called by the base class
     void do_eof(void);
@@ -41,7 +45,14 @@ class ssl_http_session : public http_session<ssl_http_session>, public virtual_e
      void on_shutdown(boost::beast::error_code ec);
 
  private:
+    // The SSL object holds its own reference to the native context, this one keeps the callbacks of the
+    // context alive during the handshake even if the context is reloaded meanwhile
+    std::shared_ptr<ssl_context_type>      ssl_context_;
     tcp_stream_type                        stream_;
+    bool                                   stream_released_;
+    std::shared_ptr<void>                  handshake_permit_;
+    // Counts the connection in the load of its io_context
+    std::shared_ptr<void>                  load_ticket_;
 };
 
 #endif  //  NET_HTTP_SESSION_SSL_H_
@@ -0,0 +1,28 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http_session_unix.h"
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+unix_http_session::unix_http_session(unix_stream_type&& stream, flat_buffer_type&& buffer):
+                                     base_type(std::move(buffer)), stream_(std::move(stream)),
+                                     load_ticket_(make_io_load_ticket(stream_.get_executor())) {
+}
+
+unix_http_session::~unix_http_session(void) {
+}
+
+void unix_http_session::run(void) {
+    this->do_read();
+}
+
+void unix_http_session::do_eof(void) {
+    // Send a shutdown
+    boost::beast::error_code ec;
+    stream_.socket().shutdown(boost::asio::local::stream_protocol::socket::shutdown_send, ec);
+    // At this point the connection is closed gracefully
+}
+
+#endif  // BOOST_ASIO_HAS_LOCAL_SOCKETS
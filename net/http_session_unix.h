@@ -0,0 +1,50 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_HTTP_SESSION_UNIX_H_
+#define NET_HTTP_SESSION_UNIX_H_
+
+#include <utility>
+#include <boost/asio/local/stream_protocol.hpp>
+#include "net/http_session.hpp"
+#include "src/io_context_pool.h"
+#include "src/scaffold_handles.h"
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+// A plain session of a local (AF_UNIX) connection, e.g. from a reverse proxy on the same host
+class unix_http_session : public http_session<unix_http_session, scaffold_http_handlers>, public virtual_enable_shared_from_this<unix_http_session> {
+ public:
+    typedef unix_http_session                                           this_type;
+    typedef http_session<this_type, scaffold_http_handlers>             base_type;
+    typedef boost::beast::basic_stream<boost::asio::local::stream_protocol> unix_stream_type;
+    typedef session_buffer_type                                         flat_buffer_type;
+
+ public:
+    unix_http_session(unix_stream_type&& stream, flat_buffer_type&& buffer);
+    ~unix_http_session(void);
+    explicit unix_http_session(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+ public:
+    void run(void);
+
+    // Called by the base class
+    unix_stream_type& stream(void) { return stream_; }
+
+    // Called by the base class
+    unix_stream_type release_stream(void) { return std::move(stream_); }
+
+    // Called by the base class
+    void do_eof(void);
+
+ private:
+    unix_stream_type                       stream_;
+    // Counts the connection in the load of its io_context
+    std::shared_ptr<void>                  load_ticket_;
+};
+
+#endif  // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+#endif  // NET_HTTP_SESSION_UNIX_H_
@@ -3,17 +3,20 @@
 // found in the LICENSE file.
 
 #include "net/listener.h"
+#include <algorithm>
 #include <utility>
 #include <string>
 #include <boost/asio/strand.hpp>
 #include <boost/lexical_cast.hpp>
 #include "base/utils.h"
 #include "net/net_utils.h"
+#include "src/server_counters.h"
 
-listener::listener(io_context_type& ioc, unsigned short port, handle_type handle) : ioc_(ioc),
-                   acceptor_(boost::asio::make_strand(ioc)), handle_(handle) {
-    auto const address = boost::asio::ip::make_address("0.0.0.0");
-    endpoint_type endpoint_instance{address, static_cast<uint_least16_t>(port)};
+template<class Protocol>
+basic_listener<Protocol>::basic_listener(io_context_type& ioc, const endpoint_type& endpoint_instance, handle_type handle, bool reuse_port,
+                                         context_handle_type context_handle) : ioc_(ioc), acceptor_(boost::asio::make_strand(ioc)),
+                                         handle_(handle), context_handle_(context_handle), timer_(acceptor_.get_executor()),
+                                         backoff_(0), paused_(false) {
     error_code_type ec;
     acceptor_.open(endpoint_instance.protocol(), ec);
     if (ec) {
@@ -24,34 +27,90 @@ listener::listener(io_context_type& ioc, unsigned short port, handle_type handle
     acceptor_.set_option(boost::asio::socket_base::reuse_address(true), ec);
     if (ec) {
         handle_error(ec, "Listener.set_option");
+        acceptor_.close(ec);
         return;
     }
 
+#ifdef SO_REUSEPORT
+    if (reuse_port) {
+        acceptor_.set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true), ec);
+        if (ec) {
+            handle_error(ec, "Listener.set_option(SO_REUSEPORT)");
+            acceptor_.close(ec);
+            return;
+        }
+    }
+#endif
+
     acceptor_.bind(endpoint_instance, ec);
     if (ec) {
         handle_error(ec, "Listener.bind");
+        acceptor_.close(ec);
         return;
     }
 
     acceptor_.listen(boost::asio::socket_base::max_listen_connections, ec);
-    if (ec)
+    if (ec) {
         handle_error(ec, "Listener.Listener");
+        acceptor_.close(ec);
+    }
 }
 
-listener::~listener(void) {
+template<class Protocol>
+basic_listener<Protocol>::~basic_listener(void) {
 }
 
-void listener::do_accept(void) {
+template<class Protocol>
+bool basic_listener<Protocol>::reuse_port_supported(void) {
+#ifdef SO_REUSEPORT
+    return true;
+#else
+    return false;
+#endif
+}
+
+template<class Protocol>
+void basic_listener<Protocol>::do_accept(void) {
+    // Over the connection limit, the new connections wait in the backlog
+    if (pause_handle_ && pause_handle_()) {
+        if (!paused_) {
+            paused_ = true;
+            server_counters_get_instance()->add(server_counters::accept_pauses);
+            LOG(WARNING) << "Listener.paused(" << boost::lexical_cast<std::string>(acceptor_.local_endpoint()) << ").";
+        }
+        return do_wait(std::chrono::milliseconds(pause_check_milliseconds));
+    }
+    paused_ = false;
+
     LOG(VERBOSE) << "Listener.Listenering(" << boost::lexical_cast<std::string>(acceptor_.local_endpoint()) << ")...";
 
     // The new connection gets its own strand
-    acceptor_.async_accept(boost::asio::make_strand(ioc_), boost::beast::bind_front_handler(&this_type::on_accept, shared_from_this()));
+    auto& socket_ioc = context_handle_ ? context_handle_() : ioc_;
+    acceptor_.async_accept(boost::asio::make_strand(socket_ioc), make_arena_handler(handler_arena_, boost::beast::bind_front_handler(&this_type::on_accept,
+                           this->shared_from_this())));
 }
 
-void listener::on_accept(error_code_type ec, socket_type socket) {
+template<class Protocol>
+void basic_listener<Protocol>::on_accept(error_code_type ec, socket_type socket) {
+    if (ec == boost::asio::error::operation_aborted || !acceptor_.is_open())
+        return;
+
     if (ec) {
         handle_error(ec, "Listener.accept");
+
+        // Accepting again at once would spin until a descriptor is freed
+        if (ec == boost::asio::error::no_descriptors || ec == boost::asio::error::no_buffer_space || ec == boost::asio::error::no_memory
+#ifdef ENFILE
+            || ec == error_code_type(ENFILE, boost::system::system_category())
+#endif
+            ) {
+            backoff_ = std::min(std::max(backoff_ * 2, std::chrono::milliseconds(backoff_min_milliseconds)),
+                                std::chrono::milliseconds(backoff_max_milliseconds));
+            server_counters_get_instance()->add(server_counters::accept_backoffs);
+            return do_wait(backoff_);
+        }
     } else {
+        backoff_ = std::chrono::milliseconds(0);
         LOG(VERBOSE) << "Listener.received(" << boost::lexical_cast<std::string>(socket.remote_endpoint())
             << " ==> " << boost::lexical_cast<std::string>(socket.local_endpoint()) << ").";
         handle_(std::move(socket));
@@ -60,3 +119,17 @@ void listener::on_accept(error_code_type ec, socket_type socket) {
     // Accept another connection
     do_accept();
 }
+
+template<class Protocol>
+void basic_listener<Protocol>::do_wait(std::chrono::milliseconds delay) {
+    timer_.expires_after(delay);
+    timer_.async_wait(make_arena_handler(handler_arena_, [self = this->shared_from_this()](error_code_type ec) {
+        if (!ec)
+            self->do_accept();
+    }));
+}
+
+template class basic_listener<boost::asio::ip::tcp>;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+template class basic_listener<boost::asio::local::stream_protocol>;
+#endif
@@ -5,37 +5,68 @@
 #ifndef NET_LISTENER_H_
 #define NET_LISTENER_H_
 
+#include <chrono>
 #include <boost/beast/core.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include "src/handler_arena.h"
 
 //////////////////////////////////////// declarations ////////////////////////////////////////
 
-class listener : public std::enable_shared_from_this<listener> {
+// A TCP or a local (AF_UNIX) stream listener, instantiated in listener.cpp
+template<class Protocol>
+class basic_listener : public std::enable_shared_from_this<basic_listener<Protocol>> {
  public:
-    typedef listener                                                this_type;
+    typedef basic_listener<Protocol>                                this_type;
     typedef boost::asio::io_context                                 io_context_type;
-    typedef boost::asio::ip::tcp::acceptor                          acceptor_type;
-    typedef boost::asio::ip::tcp::socket                            socket_type;
-    typedef boost::asio::ip::tcp::endpoint                          endpoint_type;
+    typedef typename Protocol::acceptor                             acceptor_type;
+    typedef typename Protocol::socket                               socket_type;
+    typedef typename Protocol::endpoint                             endpoint_type;
     typedef boost::beast::error_code                                error_code_type;
-    typedef std::function<void(boost::asio::ip::tcp::socket&& socket)> handle_type;
+    typedef std::function<void(socket_type&& socket)>               handle_type;
+    // The io_context of the next accepted socket, the one of the acceptor if it's null
+    typedef std::function<io_context_type&(void)>                   context_handle_type;
+    // The acceptor waits while it returns true
+    typedef std::function<bool(void)>                               pause_handle_type;
+
+    // The backoff of the accept failures for lack of resources (EMFILE, ENFILE...), and the check interval of a pause
+    enum { backoff_min_milliseconds = 10, backoff_max_milliseconds = 1000, pause_check_milliseconds = 10 };
 
  public:
-    listener(io_context_type& ioc, unsigned short port, handle_type handle);
-    ~listener(void);
-    explicit listener(const this_type&) = delete;
+    // With reuse_port, several listeners can be bound to the same port and the kernel balances the connections
+    basic_listener(io_context_type& ioc, const endpoint_type& endpoint, handle_type handle, bool reuse_port = false,
+                   context_handle_type context_handle = nullptr);
+    ~basic_listener(void);
+    explicit basic_listener(const this_type&) = delete;
     this_type& operator=(const this_type&) = delete;
 
  public:
-     void run(void) { do_accept(); }
+     void run(void) { if (acceptor_.is_open()) do_accept(); }
+     // SO_REUSEPORT is not available on every platform (Windows)
+     static bool reuse_port_supported(void);
+     acceptor_type& acceptor(void) { return acceptor_; }
+     void set_pause_handle(pause_handle_type pause_handle) { pause_handle_ = pause_handle; }
 
  private:
     void do_accept(void);
     void on_accept(error_code_type ec, socket_type socket);
+    void do_wait(std::chrono::milliseconds delay);
 
  private:
     io_context_type&            ioc_;
     acceptor_type               acceptor_;
     handle_type                 handle_;
+    context_handle_type         context_handle_;
+    pause_handle_type           pause_handle_;
+    boost::asio::steady_timer   timer_;
+    std::chrono::milliseconds   backoff_;
+    bool                        paused_;
+    handler_arena               handler_arena_;
 };
 
+typedef basic_listener<boost::asio::ip::tcp>                        listener;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+typedef basic_listener<boost::asio::local::stream_protocol>         unix_listener;
+#endif
+
 #endif  // NET_LISTENER_H_
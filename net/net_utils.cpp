@@ -4,6 +4,7 @@
 
 #include "net/net_utils.h"
 #include "base/utils.h"
+#include "src/server_counters.h"
 #include <boost/asio/ssl/error.hpp>
 
 void handle_error(boost::beast::error_code ec, char const* what) {
@@ -27,3 +28,23 @@ void handle_error(boost::beast::error_code ec, char const* what) {
         LOG(ERROR) << what << ": " << ec.message();
     }
 }
+
+void account_session_buffer(std::atomic<std::size_t>* accounted_bytes, std::size_t capacity) {
+    const std::size_t previous = accounted_bytes->exchange(capacity, std::memory_order_relaxed);
+    if (capacity > previous)
+        server_counters_get_instance()->add(server_counters::session_buffer_bytes, capacity - previous);
+    else if (capacity < previous)
+        server_counters_get_instance()->sub(server_counters::session_buffer_bytes, previous - capacity);
+}
+
+std::string remote_address(const boost::asio::ip::tcp::socket& socket) {
+    boost::beast::error_code ec;
+    const auto endpoint = socket.remote_endpoint(ec);
+    return ec ? std::string() : endpoint.address().to_string();
+}
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+std::string remote_address(const boost::asio::local::stream_protocol::socket& /*socket*/) {
+    return "local";
+}
+#endif
@@ -5,8 +5,20 @@
 #ifndef NET_NET_UTILS_H_
 #define NET_NET_UTILS_H_
 
+#include <atomic>
+#include <string>
 #include <boost/beast/core.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
 
 void handle_error(boost::beast::error_code ec, char const* what);
 
+// Keep the session_buffer_bytes counter in step with the capacity of a session buffer, 0 when the session is destroyed
+void account_session_buffer(std::atomic<std::size_t>* accounted_bytes, std::size_t capacity);
+
+// The address of the client, empty if the connection is closed. The local (AF_UNIX) clients share "local".
+std::string remote_address(const boost::asio::ip::tcp::socket& socket);
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+std::string remote_address(const boost::asio::local::stream_protocol::socket& socket);
+#endif
+
 #endif  // NET_NET_UTILS_H_
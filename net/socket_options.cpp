@@ -0,0 +1,67 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/socket_options.h"
+#include <atomic>
+#include "base/utils.h"
+#include "src/server_options.h"
+
+template<int Level, int Name>
+using integer_option = boost::asio::detail::socket_option::integer<Level, Name>;
+
+// A refused option is logged once, every connection would repeat it
+template<class Socket, class Option>
+static void set_option(Socket& socket, const Option& option, const char* name) {
+    static std::atomic<bool> k_logged(false);
+    boost::system::error_code ec;
+    socket.set_option(option, ec);
+    if (ec && !k_logged.exchange(true)) {
+        LOG(WARNING) << "set_option(" << name << "): " << ec.message();
+    }
+}
+
+void set_listener_socket_options(boost::asio::ip::tcp::acceptor& acceptor) {
+    const auto options = server_options_get_instance();
+    if (options->socket_receive_buffer)
+        set_option(acceptor, boost::asio::socket_base::receive_buffer_size(static_cast<int>(options->socket_receive_buffer)), "SO_RCVBUF");
+#ifdef TCP_DEFER_ACCEPT
+    if (options->tcp_defer_accept)
+        set_option(acceptor, integer_option<IPPROTO_TCP, TCP_DEFER_ACCEPT>(static_cast<int>(options->tcp_defer_accept)), "TCP_DEFER_ACCEPT");
+#endif
+#ifdef TCP_FASTOPEN
+    if (options->tcp_fastopen_queue)
+        set_option(acceptor, integer_option<IPPROTO_TCP, TCP_FASTOPEN>(static_cast<int>(options->tcp_fastopen_queue)), "TCP_FASTOPEN");
+#endif
+}
+
+void set_connection_socket_options(boost::asio::ip::tcp::socket& socket) {
+    const auto options = server_options_get_instance();
+    if (options->tcp_nodelay)
+        set_option(socket, boost::asio::ip::tcp::no_delay(true), "TCP_NODELAY");
+    if (options->socket_send_buffer)
+        set_option(socket, boost::asio::socket_base::send_buffer_size(static_cast<int>(options->socket_send_buffer)), "SO_SNDBUF");
+    if (options->socket_receive_buffer)
+        set_option(socket, boost::asio::socket_base::receive_buffer_size(static_cast<int>(options->socket_receive_buffer)), "SO_RCVBUF");
+
+    if (options->tcp_keepalive_idle) {
+        set_option(socket, boost::asio::socket_base::keep_alive(true), "SO_KEEPALIVE");
+#ifdef TCP_KEEPIDLE
+        set_option(socket, integer_option<IPPROTO_TCP, TCP_KEEPIDLE>(static_cast<int>(options->tcp_keepalive_idle)), "TCP_KEEPIDLE");
+#endif
+#ifdef TCP_KEEPINTVL
+        if (options->tcp_keepalive_interval)
+            set_option(socket, integer_option<IPPROTO_TCP, TCP_KEEPINTVL>(static_cast<int>(options->tcp_keepalive_interval)), "TCP_KEEPINTVL");
+#endif
+#ifdef TCP_KEEPCNT
+        if (options->tcp_keepalive_count)
+            set_option(socket, integer_option<IPPROTO_TCP, TCP_KEEPCNT>(static_cast<int>(options->tcp_keepalive_count)), "TCP_KEEPCNT");
+#endif
+    }
+
+#ifdef SO_BUSY_POLL
+    // Above net.core.busy_read, it requires CAP_NET_ADMIN
+    if (options->socket_busy_poll)
+        set_option(socket, integer_option<SOL_SOCKET, SO_BUSY_POLL>(static_cast<int>(options->socket_busy_poll)), "SO_BUSY_POLL");
+#endif
+}
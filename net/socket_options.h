@@ -0,0 +1,21 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// The socket option profile of server_options, applied to the TCP acceptors (after listen) and to the accepted
+// connections. The options which the platform doesn't know are skipped, the ones it refuses are logged:
+//
+//      acceptor:   SO_RCVBUF (inherited, sets the window scale), TCP_DEFER_ACCEPT, TCP_FASTOPEN
+//      connection: TCP_NODELAY, SO_SNDBUF, SO_RCVBUF, SO_KEEPALIVE + TCP_KEEPIDLE/KEEPINTVL/KEEPCNT, SO_BUSY_POLL
+//
+
+#ifndef NET_SOCKET_OPTIONS_H_
+#define NET_SOCKET_OPTIONS_H_
+
+#include <boost/asio/ip/tcp.hpp>
+
+void set_listener_socket_options(boost::asio::ip::tcp::acceptor& acceptor);
+void set_connection_socket_options(boost::asio::ip::tcp::socket& socket);
+
+#endif  // NET_SOCKET_OPTIONS_H_
@@ -5,76 +5,219 @@
 #ifndef NET_WEBSOCKET_SESSION_HPP_
 #define NET_WEBSOCKET_SESSION_HPP_
 
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <utility>
 #include <string>
+#include <boost/asio/dispatch.hpp>
 #include <boost/beast/websocket.hpp>
 #include "base/memory_utils.hpp"
 #include "base/utils.h"
 #include "net/net_utils.h"
+#include "net/ws_deflate_sampler.h"
+#include "src/handler_arena.h"
+#include "src/io_context_pool.h"
+#include "src/rate_limiter.h"
+#include "src/server_counters.h"
+#include "src/server_options.h"
+#include "src/session_pool.h"
+#include "src/ws_connection_registry.h"
 
-template<class Derived>
+//
+// The handlers of the connections are a policy of the session, a class with these members:
+//
+//      bool chunked(void) const        --> the messages are passed in chunks to chunk(), if ws_read_chunk_size is set
+//      void open(uintptr_t connection_handle)
+//      void close(uintptr_t connection_handle)
+//      void message(uintptr_t connection_handle, const char* message, std::size_t message_size, bool binary)
+//      void chunk(uintptr_t connection_handle, const char* chunk, std::size_t chunk_size, bool binary, bool is_final)
+//
+// The library's handlers are bound at compile time (scaffold_ws_handlers), function_ws_handlers takes any others at run time.
+//
+struct function_ws_handlers {
+    typedef std::function<void(uintptr_t)>                                                              open_handle_type;
+    typedef std::function<void(uintptr_t)>                                                              close_handle_type;
+    typedef std::function<void(uintptr_t, const char*, std::size_t, bool)>                              message_handle_type;
+    typedef std::function<void(uintptr_t, const char*, std::size_t, bool, bool)>                        chunk_handle_type;
+
+    bool chunked(void) const { return static_cast<bool>(chunk_handle); }
+    void open(uintptr_t connection_handle) { if (open_handle) open_handle(connection_handle); }
+    void close(uintptr_t connection_handle) { if (close_handle) close_handle(connection_handle); }
+    void message(uintptr_t connection_handle, const char* message, std::size_t message_size, bool binary) {
+        if (message_handle)
+            message_handle(connection_handle, message, message_size, binary);
+    }
+    void chunk(uintptr_t connection_handle, const char* chunk, std::size_t chunk_size, bool binary, bool is_final) {
+        chunk_handle(connection_handle, chunk, chunk_size, binary, is_final);
+    }
+
+    open_handle_type                open_handle;
+    close_handle_type               close_handle;
+    message_handle_type             message_handle;
+    chunk_handle_type               chunk_handle;
+};
+
+template<class Derived, class Handlers>
 class websocket_session : virtual public virtual_enable_shared_from_this_base {
  public:
     typedef Derived                                             derived_type;
-    typedef websocket_session<derived_type>                     this_type;
-    typedef boost::beast::flat_buffer                           flat_buffer_type;
-    typedef std::function<void(std::shared_ptr<virtual_enable_shared_from_this_base>)>                  open_handle_type;
-    typedef std::function<void(virtual_enable_shared_from_this_base*)>                                  close_handle_type;
-    typedef std::function<void(std::shared_ptr<virtual_enable_shared_from_this_base>, const char*)>     message_handle_type;
+    typedef Handlers                                            handlers_type;
+    typedef websocket_session<derived_type, handlers_type>      this_type;
+    typedef session_buffer_type                                 flat_buffer_type;
+    typedef std::shared_ptr<const std::string>                                                          payload_type;
+
+    // The write buffer of permessage-deflate is smaller in the low-memory mode
+    enum { retained_buffer_size = 64 * 1024, low_memory_write_buffer_size = 1024 };
+
+    struct outbound_message {
+        payload_type        payload;
+        std::string         key;
+        bool                binary;
+    };
 
  public:
-    websocket_session(open_handle_type open_handle, close_handle_type close_handle, message_handle_type message_handle) : open_handle_(open_handle),
-                      close_handle_(close_handle), message_handle_(message_handle), INSTANCE_LOG_IMPL {}
+    explicit websocket_session(handlers_type handlers = handlers_type()) : handlers_(std::move(handlers)),
+                      read_chunk_size_(handlers_.chunked() ? server_options_get_instance()->ws_read_chunk_size : 0), connection_handle_(0), deflate_negotiated_(false), writing_(false), queued_bytes_(0),
+                      write_queue_limit_(server_options_get_instance()->ws_write_queue_limit),
+                      write_queue_policy_(server_options_get_instance()->ws_write_queue_policy),
+                      deflate_min_size_(server_options_get_instance()->ws_deflate_min_size), reading_message_(false),
+                      message_rate_limited_(false), low_memory_(server_options_get_instance()->low_memory), buffer_bytes_(0), INSTANCE_LOG_IMPL {
+        if (server_options_get_instance()->connection_buffer_max)
+            buffer_.max_size(server_options_get_instance()->connection_buffer_max);
+    }
     ~websocket_session(void) {
-        virtual_enable_shared_from_this_base* pThis = this;
-        if (close_handle_)
-            close_handle_(pThis);
+        account_session_buffer(&buffer_bytes_, 0);
+        // The connection is unregistered after the close handler, so its attributes are still readable there
+        if (connection_handle_) {
+            handlers_.close(connection_handle_);
+            ws_connection_registry_get_instance()->remove(connection_handle_);
+        }
     }
 
  public:
     template<class Body, class Allocator>
     void run(boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> req) {
+        load_ticket_ = make_io_load_ticket(derived().ws().get_executor());
         do_accept(std::move(req));
     }
 
+    uintptr_t connection_handle(void) const { return connection_handle_; }
+
+    // Counts the connection in the admission control
+    void set_admission_ticket(std::shared_ptr<void> admission_ticket) { admission_ticket_ = admission_ticket; }
+
+    std::size_t queued_bytes(void) const { return queued_bytes_.load(std::memory_order_relaxed); }
+
+    // An estimate of the memory held by the connection: the session, its read buffer, its outbound queue, the slots of
+    // its operations and its zlib state
+    std::size_t memory_bytes(void) const {
+        const auto options = server_options_get_instance();
+        return sizeof(derived_type) + buffer_bytes_.load(std::memory_order_relaxed) + queued_bytes() + handler_arena_.memory_bytes() +
+               (deflate_negotiated_ ? static_cast<std::size_t>(ws_deflate_memory_per_connection(options->ws_deflate_window_bits,
+                                                                                                options->ws_deflate_mem_level)) : 0);
+    }
+
     void send(const char* message) {
-        derived().ws().text(true);
-        std::shared_ptr<std::string> sp_message = std::make_shared<std::string>(message);
-        derived().ws().async_write(boost::asio::buffer(*sp_message), boost::beast::bind_front_handler(&websocket_session::on_write,
-                                   derived().shared_from_this(), sp_message));
+        send(std::make_shared<const std::string>(message));
+    }
+
+    // It may be called from any thread: the message is queued on the session's strand.
+    // The payload is shared (not copied) by all the recipients of a broadcast.
+    void send(payload_type sp_message, std::string key = std::string(), bool binary = false) {
+        boost::asio::dispatch(derived().ws().get_executor(), bind_arena([this, self = derived().shared_from_this(), sp_message, key, binary]() mutable {
+            enqueue(outbound_message{ std::move(sp_message), std::move(key), binary });
+        }));
     }
 
  private:
     derived_type& derived(void) { return static_cast<derived_type&>(*this);}
+    // The async operations of the session are allocated by its arena
+    template<class Handler>
+    arena_handler<typename std::decay<Handler>::type> bind_arena(Handler&& handler) {
+        return make_arena_handler(handler_arena_, std::forward<Handler>(handler));
+    }
+
     template<class Body, class Allocator>
     void do_accept(boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> req) {
         // Set suggested timeout settings for the websocket
         derived().ws().set_option(boost::beast::websocket::stream_base::timeout::suggested(boost::beast::role_type::server));
+        derived().ws().read_message_max(static_cast<std::size_t>(server_options_get_instance()->ws_read_message_max));
+        if (low_memory_)
+            derived().ws().write_buffer_bytes(low_memory_write_buffer_size);
 
-        // Set a decorator to change the Server of the handshake
-        derived().ws().set_option(boost::beast::websocket::stream_base::decorator([](boost::beast::websocket::response_type& res) {
+        // Offer permessage-deflate to the clients which ask for it
+        const auto options = server_options_get_instance();
+        if (options->ws_deflate_enable) {
+            boost::beast::websocket::permessage_deflate deflate_option;
+            deflate_option.server_enable = true;
+            deflate_option.server_max_window_bits = options->ws_deflate_window_bits;
+            deflate_option.client_max_window_bits = options->ws_deflate_window_bits;
+            deflate_option.server_no_context_takeover = options->ws_deflate_no_context_takeover;
+            deflate_option.client_no_context_takeover = options->ws_deflate_no_context_takeover;
+            deflate_option.compLevel = options->ws_deflate_comp_level;
+            deflate_option.memLevel = options->ws_deflate_mem_level;
+            set_deflate_threshold(deflate_option, options->ws_deflate_min_size, 0);
+            derived().ws().set_option(deflate_option);
+        }
+
+        // Set a decorator to change the Server of the handshake, the extensions are already negotiated when it is called
+        derived().ws().set_option(boost::beast::websocket::stream_base::decorator([this](boost::beast::websocket::response_type& res) {
             res.set(boost::beast::http::field::server, std::string(BOOST_BEAST_VERSION_STRING) + " advanced-server-flex");
+            deflate_negotiated_ = res.count(boost::beast::http::field::sec_websocket_extensions) != 0;
         }));
 
+        // The messages are rate limited by the route and the client of the upgrade request
+        if (rate_limiter_get_instance()->enabled()) {
+            const auto& key_header = rate_limiter_get_instance()->key_header();
+            auto it = key_header.empty() ? req.end() : req.find(key_header);
+            rate_limit_target_ = std::string(req.target());
+            rate_limit_address_ = remote_address(boost::beast::get_lowest_layer(derived().ws()).socket());
+            rate_limit_key_ = it != req.end() ? std::string(it->value()) : std::string();
+        }
+
         // Accept the websocket handshake
-        derived().ws().async_accept(req, boost::beast::bind_front_handler(&websocket_session::on_accept, derived().shared_from_this()));
+        derived().ws().async_accept(req, bind_arena(boost::beast::bind_front_handler(&websocket_session::on_accept, derived().shared_from_this())));
+    }
+
+    // The minimum size to compress is applied by Beast when it supports it (msg_size_threshold, Boost 1.76 and later)
+    template<class Option>
+    static auto set_deflate_threshold(Option& option, std::size_t min_size, int) -> decltype(option.msg_size_threshold = min_size, void()) {
+        option.msg_size_threshold = min_size;
     }
+    template<class Option>
+    static void set_deflate_threshold(Option&, std::size_t, long) {}
 
     void on_accept(boost::beast::error_code ec) {
         if (ec)
             return handle_error(ec, "websocket_session.on_accept");
 
-        if (open_handle_)
-            open_handle_(shared_from_this());
+        // A connection without a handle can't be sent to nor closed: it's refused, the client may retry later
+        connection_handle_ = ws_connection_registry_get_instance()->add(derived().shared_from_this());
+        if (!connection_handle_) {
+            LOG(WARNING) << "websocket_session.on_accept: the connection registry is full.";
+            return derived().ws().async_close(boost::beast::websocket::close_code::try_again_later,
+                                              bind_arena(boost::beast::bind_front_handler(&websocket_session::on_close, derived().shared_from_this())));
+        }
+        handlers_.open(connection_handle_);
 
         // Read a message
         do_read();
     }
 
+    void on_close(boost::beast::error_code ec) {
+        if (ec)
+            return handle_error(ec, "websocket_session.on_close");
+    }
+
     void do_read(void) {
-        // Read a message into our buffer
-        derived().ws().async_read(buffer_, boost::beast::bind_front_handler(&websocket_session::on_read, derived().shared_from_this()));
+        // Read a message into our buffer, or the next fragment of it in the streaming mode
+        if (read_chunk_size_)
+            derived().ws().async_read_some(buffer_, read_chunk_size_, bind_arena(boost::beast::bind_front_handler(&websocket_session::on_read,
+                                           derived().shared_from_this())));
+        else
+            derived().ws().async_read(buffer_, bind_arena(boost::beast::bind_front_handler(&websocket_session::on_read,
+                                      derived().shared_from_this())));
     }
 
     void on_read(boost::beast::error_code ec, std::size_t bytes_transferred) {
@@ -87,28 +230,142 @@ class websocket_session : virtual public virtual_enable_shared_from_this_base {
         if (ec) {
             handle_error(ec, "websocket_session.on_read");
         } else {
-            const std::string message = boost::beast::buffers_to_string(buffer_.data());
+            // A message over the rate limit is dropped, its first fragment decides in the streaming mode
+            if (!reading_message_)
+                message_rate_limited_ = !rate_limit_admit();
+            reading_message_ = !derived().ws().is_message_done();
+
+            // The flat buffer is contiguous: the handler gets a view into it, which is valid during the call only
+            const auto message = buffer_.data();
+            if (message_rate_limited_)
+                LOG(VERBOSE) << "websocket_session(" << connection_handle_ << "): the message is over the rate limit.";
+            else if (read_chunk_size_)
+                handlers_.chunk(connection_handle_, static_cast<const char*>(message.data()), message.size(), derived().ws().got_binary(),
+                                derived().ws().is_message_done());
+            else
+                handlers_.message(connection_handle_, static_cast<const char*>(message.data()), message.size(), derived().ws().got_binary());
             buffer_.consume(buffer_.size());  // Clear the buffer
-            if (message_handle_)
-                message_handle_(shared_from_this(), message.c_str());
+
+            // Don't hold the memory of a large message (of any message in the low-memory mode) while the connection is idle
+            if (buffer_.capacity() > (low_memory_ ? 0 : static_cast<std::size_t>(retained_buffer_size)))
+                buffer_.shrink_to_fit();
+            account_session_buffer(&buffer_bytes_, buffer_.capacity());
 
             do_read();
         }
     }
 
-    void on_write(std::shared_ptr<std::string> sp_message, boost::beast::error_code ec, std::size_t bytes_transferred) {
-        boost::ignore_unused(sp_message);
+    bool rate_limit_admit(void) {
+        if (rate_limit_target_.empty() || rate_limiter_get_instance()->admit(rate_limit_target_, rate_limit_address_, rate_limit_key_, nullptr))
+            return true;
+        server_counters_get_instance()->add(server_counters::rate_limited_ws_messages);
+        return false;
+    }
+
+    // The queued bytes only count the messages in the queue: the ones still on their way to the strand don't trigger the overflow
+    void enqueue(outbound_message&& message) {
+        queued_bytes_.fetch_add(message.payload->size(), std::memory_order_relaxed);
+        write_queue_.emplace_back(std::move(message));
+        if (write_queue_limit_ && write_queue_.size() > 1 && queued_bytes() > write_queue_limit_)
+            handle_write_queue_overflow();
+        if (!writing_ && !write_queue_.empty())
+            do_write();
+    }
+
+    void handle_write_queue_overflow(void) {
+        // The front message is being written while writing_ is set, it can't be dropped
+        const std::size_t first_unsent = writing_ ? 1 : 0;
+        switch (write_queue_policy_) {
+        case WS_QUEUE_CLOSE:
+            LOG(WARNING) << "websocket_session(" << connection_handle_ << "): the slow consumer is closed, " << queued_bytes() << " bytes queued.";
+            drop_messages(first_unsent, write_queue_.size());
+            boost::beast::get_lowest_layer(derived().ws()).close();
+            return;
+
+        case WS_QUEUE_CONFLATE:
+            if (!write_queue_.back().key.empty()) {
+                // Replace the latest unsent message with the same key by the new one
+                for (std::size_t i = write_queue_.size() - 1; i > first_unsent; --i) {
+                    if (write_queue_[i - 1].key == write_queue_.back().key) {
+                        std::swap(write_queue_[i - 1], write_queue_.back());
+                        drop_messages(write_queue_.size() - 1, write_queue_.size());
+                        return;
+                    }
+                }
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        // Drop the oldest unsent messages, but keep the newest one
+        std::size_t last = first_unsent;
+        for (std::size_t bytes = queued_bytes(); bytes > write_queue_limit_ && last + 1 < write_queue_.size(); ++last)
+            bytes -= write_queue_[last].payload->size();
+        if (last > first_unsent) {
+            LOG(VERBOSE) << "websocket_session(" << connection_handle_ << "): " << (last - first_unsent) << " messages are dropped.";
+            drop_messages(first_unsent, last);
+        }
+    }
+
+    void drop_messages(std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i)
+            queued_bytes_.fetch_sub(write_queue_[i].payload->size(), std::memory_order_relaxed);
+        write_queue_.erase(write_queue_.begin() + first, write_queue_.begin() + last);
+    }
+
+    void do_write(void) {
+        writing_ = true;
+        const auto& payload = *write_queue_.front().payload;
+        if (deflate_negotiated_ && payload.size() >= deflate_min_size_)
+            ws_deflate_account(payload.data(), payload.size());
+        derived().ws().binary(write_queue_.front().binary);
+        derived().ws().async_write(boost::asio::buffer(payload), bind_arena(boost::beast::bind_front_handler(&websocket_session::on_write,
+                                   derived().shared_from_this())));
+    }
+
+    void on_write(boost::beast::error_code ec, std::size_t bytes_transferred) {
         boost::ignore_unused(bytes_transferred);
 
-        if (ec)
+        drop_messages(0, 1);
+        writing_ = false;
+        if (ec) {
+            drop_messages(0, write_queue_.size());
             return handle_error(ec, "websocket_session.on_write");
+        }
+
+        if (!write_queue_.empty())
+            do_write();
     }
 
  protected:
     flat_buffer_type                buffer_;
-    open_handle_type                open_handle_;
-    close_handle_type               close_handle_;
-    message_handle_type             message_handle_;
+    handlers_type                   handlers_;
+    std::size_t                     read_chunk_size_;
+    uintptr_t                       connection_handle_;
+    bool                            deflate_negotiated_;
+    // The outbound queue, its front message is being written while writing_ is set
+    std::deque<outbound_message>    write_queue_;
+    bool                            writing_;
+    // Updated on the strand with the queue, read by ws_queued_bytes from any thread
+    std::atomic<std::size_t>        queued_bytes_;
+    std::size_t                     write_queue_limit_;
+    int                             write_queue_policy_;
+    std::size_t                     deflate_min_size_;
+    // Counts the connection in the load of its io_context
+    std::shared_ptr<void>           load_ticket_;
+    std::shared_ptr<void>           admission_ticket_;
+    // The route and the client of the rate limiter, the target is empty if there is no limit
+    std::string                     rate_limit_target_;
+    std::string                     rate_limit_address_;
+    std::string                     rate_limit_key_;
+    bool                            reading_message_;
+    bool                            message_rate_limited_;
+    bool                            low_memory_;
+    // The capacity of buffer_ in the session_buffer_bytes counter
+    std::atomic<std::size_t>        buffer_bytes_;
+    handler_arena                   handler_arena_;
     INSTANCE_LOG_DECLARE;
 };
 
@@ -9,20 +9,36 @@
 #include <utility>
 #include "net/websocket_session_plain.h"
 #include "net/websocket_session_ssl.h"
-#include "src/scaffold_handles.h"
+#include "net/websocket_session_unix.h"
+#include "src/session_pool.h"
 
 template<class Body, class Allocator>
 inline void make_websocket_session(boost::beast::tcp_stream stream,
-                                   boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> req) {
-    std::make_shared<plain_websocket_session>(std::move(stream), handle_ws_connection_open,
-                                        handle_ws_connection_close, handle_ws_message)->run(std::move(req));
+                                   boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> req,
+                                   std::shared_ptr<void> admission_ticket) {
+    auto sp_session = make_pooled_shared<plain_websocket_session>(std::move(stream));
+    sp_session->set_admission_ticket(std::move(admission_ticket));
+    sp_session->run(std::move(req));
 }
 
 template<class Body, class Allocator>
 inline void make_websocket_session(boost::beast::ssl_stream<boost::beast::tcp_stream> stream,
-                                   boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> req) {
-    std::make_shared<ssl_websocket_session>(std::move(stream), handle_ws_connection_open,
-                                      handle_ws_connection_close, handle_ws_message)->run(std::move(req));
+                                   boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> req,
+                                   std::shared_ptr<void> admission_ticket) {
+    auto sp_session = make_pooled_shared<ssl_websocket_session>(std::move(stream));
+    sp_session->set_admission_ticket(std::move(admission_ticket));
+    sp_session->run(std::move(req));
 }
 
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+template<class Body, class Allocator>
+inline void make_websocket_session(boost::beast::basic_stream<boost::asio::local::stream_protocol> stream,
+                                   boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> req,
+                                   std::shared_ptr<void> admission_ticket) {
+    auto sp_session = make_pooled_shared<unix_websocket_session>(std::move(stream));
+    sp_session->set_admission_ticket(std::move(admission_ticket));
+    sp_session->run(std::move(req));
+}
+#endif
+
 #endif  // NET_WEBSOCKET_SESSION_FACTORY_HPP_
@@ -7,17 +7,17 @@
 
 #include <utility>
 #include "net/websocket_session.hpp"
+#include "src/scaffold_handles.h"
 
-class plain_websocket_session : public websocket_session<plain_websocket_session>,
+class plain_websocket_session : public websocket_session<plain_websocket_session, scaffold_ws_handlers>,
                                 public virtual_enable_shared_from_this<plain_websocket_session> {
  public:
-    typedef websocket_session<plain_websocket_session>                              base_type;
+    typedef websocket_session<plain_websocket_session, scaffold_ws_handlers>        base_type;
     typedef plain_websocket_session                                                 this_type;
     typedef boost::beast::websocket::stream<boost::beast::tcp_stream>               ws_stream_type;
 
  public:
-    explicit plain_websocket_session(boost::beast::tcp_stream&& stream, open_handle_type open_handle, close_handle_type close_handle,
-                        message_handle_type message_handle) : base_type(open_handle, close_handle, message_handle), ws_(std::move(stream)) {}
+    explicit plain_websocket_session(boost::beast::tcp_stream&& stream) : ws_(std::move(stream)) {}
     ~plain_websocket_session(void) {}
 
  public:
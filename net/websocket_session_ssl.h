@@ -8,19 +8,19 @@
 #include <utility>
 #include <boost/beast/ssl.hpp>
 #include "net/websocket_session.hpp"
+#include "src/scaffold_handles.h"
+#include "src/ssl_session_cache.h"
 
-class ssl_websocket_session : public websocket_session<ssl_websocket_session>,
+class ssl_websocket_session : public websocket_session<ssl_websocket_session, scaffold_ws_handlers>,
                               public virtual_enable_shared_from_this<ssl_websocket_session> {
  public:
-    typedef websocket_session<ssl_websocket_session>                                base_type;
+    typedef websocket_session<ssl_websocket_session, scaffold_ws_handlers>          base_type;
     typedef ssl_websocket_session                                                   this_type;
     typedef boost::beast::websocket::stream<boost::beast::ssl_stream<boost::beast::tcp_stream> > ws_stream_type;
 
  public:
-     explicit ssl_websocket_session(boost::beast::ssl_stream<boost::beast::tcp_stream>&& stream, open_handle_type open_handle,
-                                    close_handle_type close_handle, message_handle_type message_handle):
-                                    base_type(open_handle, close_handle, message_handle), ws_(std::move(stream)) {}
-     ~ssl_websocket_session(void) {}
+     explicit ssl_websocket_session(boost::beast::ssl_stream<boost::beast::tcp_stream>&& stream) : ws_(std::move(stream)) {}
+     ~ssl_websocket_session(void) { keep_ssl_session_resumable(ws_.next_layer().native_handle()); }
 
  public:
     // Called by the base class
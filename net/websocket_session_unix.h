@@ -0,0 +1,37 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_WEBSOCKET_SESSION_UNIX_H_
+#define NET_WEBSOCKET_SESSION_UNIX_H_
+
+#include <utility>
+#include <boost/asio/local/stream_protocol.hpp>
+#include "net/websocket_session.hpp"
+#include "src/scaffold_handles.h"
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+class unix_websocket_session : public websocket_session<unix_websocket_session, scaffold_ws_handlers>,
+                               public virtual_enable_shared_from_this<unix_websocket_session> {
+ public:
+    typedef websocket_session<unix_websocket_session, scaffold_ws_handlers>         base_type;
+    typedef unix_websocket_session                                                  this_type;
+    typedef boost::beast::basic_stream<boost::asio::local::stream_protocol>         unix_stream_type;
+    typedef boost::beast::websocket::stream<unix_stream_type>                       ws_stream_type;
+
+ public:
+    explicit unix_websocket_session(unix_stream_type&& stream) : ws_(std::move(stream)) {}
+    ~unix_websocket_session(void) {}
+
+ public:
+    // Called by the base class
+    ws_stream_type& ws(void) { return ws_;}
+
+ private:
+    ws_stream_type                ws_;
+};
+
+#endif  // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+#endif  // NET_WEBSOCKET_SESSION_UNIX_H_
@@ -0,0 +1,49 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/ws_deflate_sampler.h"
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include "src/server_counters.h"
+#include "src/server_options.h"
+
+void ws_deflate_account(const char* data, std::size_t size) {
+    static std::atomic<uint64_t> k_sequence(0);
+    auto counters = server_counters_get_instance();
+    counters->add(server_counters::ws_deflate_messages);
+    counters->add(server_counters::ws_deflate_raw_bytes, size);
+    if (k_sequence.fetch_add(1, std::memory_order_relaxed) % ws_deflate_sample_interval)
+        return;
+
+    const auto options = server_options_get_instance();
+    thread_local boost::beast::zlib::deflate_stream k_deflate_stream;
+    thread_local std::vector<unsigned char> k_output;
+
+    const auto start = std::chrono::steady_clock::now();
+    k_deflate_stream.reset(options->ws_deflate_comp_level, options->ws_deflate_window_bits, options->ws_deflate_mem_level,
+                           boost::beast::zlib::Strategy::normal);
+    k_output.resize(k_deflate_stream.upper_bound(size) + 16);
+    boost::beast::zlib::z_params params;
+    params.next_in = data;
+    params.avail_in = size;
+    params.next_out = k_output.data();
+    params.avail_out = k_output.size();
+    boost::beast::error_code ec;
+    k_deflate_stream.write(params, boost::beast::zlib::Flush::sync, ec);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    if (ec && ec != boost::beast::zlib::error::need_buffers)
+        return;
+
+    // The trailing 4 bytes of the sync flush are not sent (RFC 7692 7.2.1)
+    counters->add(server_counters::ws_deflate_sampled_messages);
+    counters->add(server_counters::ws_deflate_sampled_raw_bytes, size);
+    counters->add(server_counters::ws_deflate_sampled_compressed_bytes, params.total_out > 4 ? params.total_out - 4 : params.total_out);
+    counters->add(server_counters::ws_deflate_sampled_cpu_nanoseconds, elapsed.count());
+}
+
+uint64_t ws_deflate_memory_per_connection(int window_bits, int mem_level) {
+    return (uint64_t(1) << (window_bits + 2)) + (uint64_t(1) << (mem_level + 9)) + (uint64_t(1) << window_bits);
+}
@@ -0,0 +1,25 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Beast doesn't report what permessage-deflate saves nor what it costs, so one outbound message in
+// ws_deflate_sample_interval is compressed again with the same settings and timed. The estimation starts
+// from an empty window each time, so it is pessimistic when the context is taken over between messages.
+//
+
+#ifndef NET_WS_DEFLATE_SAMPLER_H_
+#define NET_WS_DEFLATE_SAMPLER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+enum { ws_deflate_sample_interval = 32 };
+
+// Account an outbound message of a connection which negotiated permessage-deflate
+void ws_deflate_account(const char* data, std::size_t size);
+
+// The zlib memory held by a connection: the deflate state plus the inflate window
+uint64_t ws_deflate_memory_per_connection(int window_bits, int mem_level);
+
+#endif  // NET_WS_DEFLATE_SAMPLER_H_
@@ -3,6 +3,43 @@
 // found in the LICENSE file.
 
 #include "os_glue/os_glue.h"
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstdint>
 
 void os_set_console_close_handle(std::function<void(void)> close_cb) {
 }
+
+int os_event_fd_create(void) {
+    return eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+void os_event_fd_notify(int event_fd) {
+    uint64_t value = 1;
+    if (write(event_fd, &value, sizeof(value)) < 0) {
+        // The counter is saturated or the descriptor is closed: the reader is woken up anyway
+    }
+}
+
+void os_event_fd_reset(int event_fd) {
+    uint64_t value = 0;
+    if (read(event_fd, &value, sizeof(value)) < 0) {
+        // Nothing to reset (EAGAIN)
+    }
+}
+
+void os_event_fd_close(int event_fd) {
+    if (event_fd >= 0)
+        close(event_fd);
+}
+
+bool os_set_thread_affinity(int cpu_index) {
+    if (cpu_index < 0 || cpu_index >= CPU_SETSIZE)
+        return false;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu_index, &cpu_set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+}
@@ -9,4 +9,14 @@
 
 void os_set_console_close_handle(std::function<void(void)> close_cb);
 
+// Event descriptor which can be watched by a foreign event loop (select/epoll/asyncio).
+// os_event_fd_create returns -1 if the platform has no such primitive.
+int os_event_fd_create(void);
+void os_event_fd_notify(int event_fd);
+void os_event_fd_reset(int event_fd);
+void os_event_fd_close(int event_fd);
+
+// Pin the calling thread to a CPU (0-based), returns false if the platform or the CPU doesn't allow it.
+bool os_set_thread_affinity(int cpu_index);
+
 #endif  // OS_GLUE_OS_GLUE_H_
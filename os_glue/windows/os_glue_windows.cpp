@@ -32,6 +32,19 @@ void os_set_console_close_handle(std::function<void(void)> close_cb) {
         SetConsoleCtrlHandler(NULL, FALSE);
 }
 
+int os_event_fd_create(void) {
+    return -1;  // Windows has no pollable event descriptor, the caller falls back to a wakeup callback
+}
+
+void os_event_fd_notify(int event_fd) {
+}
+
+void os_event_fd_reset(int event_fd) {
+}
+
+void os_event_fd_close(int event_fd) {
+}
+
 BOOL WINAPI DllMain(HINSTANCE /*hInstance*/, DWORD dwReason, LPVOID) {
     switch (dwReason) {
     case DLL_PROCESS_ATTACH:
@@ -45,3 +58,9 @@ BOOL WINAPI DllMain(HINSTANCE /*hInstance*/, DWORD dwReason, LPVOID) {
     }
     return TRUE;
 }
+
+bool os_set_thread_affinity(int cpu_index) {
+    if (cpu_index < 0 || cpu_index >= static_cast<int>(sizeof(DWORD_PTR) * 8))
+        return false;
+    return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu_index) != 0;
+}
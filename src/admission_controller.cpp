@@ -0,0 +1,95 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/admission_controller.h"
+#include "include/beast_utils.h"
+#include "src/server_counters.h"
+
+admission_controller::admission_controller(void) : active_(0), paused_(false), max_connections_(0), max_connections_per_ip_(0),
+                                                   overload_policy_(ADMISSION_REJECT) {
+}
+
+admission_controller::~admission_controller(void) {
+}
+
+void admission_controller::set_limits(uint32_t max_connections, uint32_t max_connections_per_ip, int overload_policy) {
+    max_connections_ = max_connections;
+    max_connections_per_ip_ = max_connections_per_ip;
+    overload_policy_ = overload_policy;
+}
+
+bool admission_controller::admit(const address_type& address, ticket_type* ticket) {
+    if (!max_connections_per_ip_)
+        return admit(std::string(), ticket);
+
+    // The IPv4 clients are counted by their IPv4 address on a dual-stack endpoint too
+    std::string key;
+    if (address.is_v6() && address.to_v6().is_v4_mapped()) {
+        const auto bytes = address.to_v6().to_v4().to_bytes();
+        key.assign(bytes.begin(), bytes.end());
+    } else if (address.is_v6()) {
+        const auto bytes = address.to_v6().to_bytes();
+        key.assign(bytes.begin(), bytes.end());
+    } else {
+        const auto bytes = address.to_v4().to_bytes();
+        key.assign(bytes.begin(), bytes.end());
+    }
+    return admit(key, ticket);
+}
+
+bool admission_controller::admit(ticket_type* ticket) {
+    return admit(std::string(), ticket);
+}
+
+bool admission_controller::admit(const std::string& key, ticket_type* ticket) {
+    // With ADMISSION_PAUSE, the few connections accepted before the acceptors paused are admitted
+    const uint32_t active = active_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (max_connections_ && active > max_connections_ && overload_policy_ == ADMISSION_REJECT) {
+        active_.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (!key.empty()) {
+        lock_type lock(mutex_);
+        auto& count = connections_per_ip_[key];
+        if (count >= max_connections_per_ip_) {
+            if (!count)
+                connections_per_ip_.erase(key);
+            lock.unlock();
+            active_.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        ++count;
+    }
+
+    server_counters_get_instance()->add(server_counters::connections_active);
+    *ticket = ticket_type(static_cast<void*>(this), [key](void* controller) { static_cast<this_type*>(controller)->release(key); });
+    return true;
+}
+
+bool admission_controller::accept_paused(void) {
+    if (!max_connections_ || overload_policy_ != ADMISSION_PAUSE)
+        return false;
+
+    // The hysteresis keeps the acceptors from flapping around the limit
+    const uint32_t active = active_.load(std::memory_order_relaxed);
+    if (paused_.load(std::memory_order_relaxed)) {
+        if (active <= static_cast<uint64_t>(max_connections_) * resume_percent / 100)
+            paused_.store(false, std::memory_order_relaxed);
+    } else if (active >= max_connections_) {
+        paused_.store(true, std::memory_order_relaxed);
+    }
+    return paused_.load(std::memory_order_relaxed);
+}
+
+void admission_controller::release(const std::string& key) {
+    if (!key.empty()) {
+        lock_type lock(mutex_);
+        auto it = connections_per_ip_.find(key);
+        if (it != connections_per_ip_.end() && --it->second == 0)
+            connections_per_ip_.erase(it);
+    }
+    active_.fetch_sub(1, std::memory_order_relaxed);
+    server_counters_get_instance()->sub(server_counters::connections_active);
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Bounds the opened connections, globally and per client address. An admitted connection holds a ticket which
+// is handed from session to session (detect, http, websocket), the connection is released with its last one:
+//
+//      admit(address, &ticket) --> false: over the limit, the connection is shed
+//      accept_paused()         --> the acceptors wait while the server is full (ADMISSION_PAUSE)
+//
+
+#ifndef SRC_ADMISSION_CONTROLLER_H_
+#define SRC_ADMISSION_CONTROLLER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <boost/asio/ip/address.hpp>
+
+class admission_controller {
+ public:
+    typedef admission_controller                                            this_type;
+    typedef std::mutex                                                      mutex_type;
+    typedef std::unique_lock<mutex_type>                                    lock_type;
+    typedef boost::asio::ip::address                                        address_type;
+    typedef std::shared_ptr<void>                                           ticket_type;
+
+    // The paused acceptors resume when the connections fall to this share of the limit
+    enum { resume_percent = 90 };
+
+ public:
+    admission_controller(void);
+    ~admission_controller(void);
+    explicit admission_controller(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+ public:
+    // 0 means unlimited, overload_policy: ADMISSION_XXX (over the global limit)
+    void set_limits(uint32_t max_connections, uint32_t max_connections_per_ip, int overload_policy);
+    // The connections over the limit per address are always refused
+    bool admit(const address_type& address, ticket_type* ticket);
+    // A local connection has no address, only the global limit applies
+    bool admit(ticket_type* ticket);
+    bool accept_paused(void);
+    uint32_t active(void) const { return active_.load(std::memory_order_relaxed); }
+
+ private:
+    bool admit(const std::string& key, ticket_type* ticket);
+    void release(const std::string& key);
+
+ private:
+    mutex_type                                  mutex_;
+    std::unordered_map<std::string, uint32_t>   connections_per_ip_;
+    std::atomic<uint32_t>                       active_;
+    std::atomic<bool>                           paused_;
+    uint32_t                                    max_connections_;
+    uint32_t                                    max_connections_per_ip_;
+    int                                         overload_policy_;
+};
+
+admission_controller* admission_controller_get_instance(void);
+
+#endif  // SRC_ADMISSION_CONTROLLER_H_
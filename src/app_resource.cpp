@@ -8,12 +8,14 @@
 #include <thread>
 #include "base/utils.h"
 #include "base/console_close.h"
+#include "src/handler_arena.h"
+#include "src/session_pool.h"
 #include "src/ssl_certificate.h"
 #include "os_glue/os_glue.h"
 #include "net/listener.h"
 #include "base/task_utils.hpp"
 
-app_resource::app_resource(void) : io_context_(nullptr), ssl_context_(nullptr) {
+app_resource::app_resource(void) : io_context_(nullptr), tls_io_context_(nullptr), io_context_pool_(nullptr), ssl_enabled_(false) {
 }
 
 app_resource::~app_resource(void) {
@@ -45,18 +47,59 @@ int app_resource::run_server(unsigned short port, bool ssl, int thread_count) {
                 handler_pair.first(handler_pair.second);
         });
 
-        // The io_context is required for all I/O
+        // The io_context is required for all I/O. With an io_context per thread, it runs the signals and the tasks on
+        // the calling thread, and the acceptors and the connections run on the pool.
         thread_count = std::max<int>(1, thread_count);
-        boost::asio::io_context ioc{ thread_count };
+        const bool per_thread = server_options_.io_context_per_thread;
+        boost::asio::io_context ioc{ per_thread ? 1 : thread_count };
         io_context_ = &ioc;
         scope_exit += [this]() { io_context_ = nullptr; };
+        std::unique_ptr<io_context_pool_type> pool(per_thread ? new io_context_pool_type(thread_count, server_options_.io_distribution) : nullptr);
+        if (pool) {
+            io_context_pool_ = pool.get();
+            pool->run(server_options_.io_cpu_affinity);
+        }
 
         // The SSL context is required, and holds certificates
-        ssl_context_type ssl_context{ ssl_context_type::tlsv12 };
-        if (ssl)
-            load_server_certificate(&ssl_context);
-        ssl_context_ = &ssl_context;
-        scope_exit += [this]() { this->ssl_context_ = nullptr; };
+        bool ssl_success = false;
+        std::atomic_store(&ssl_context_, ssl ? make_server_ssl_context(server_options_, &ssl_success) :
+                          std::make_shared<ssl_context_type>(ssl_context_type::tls_server));
+        ssl_enabled_ = ssl;
+        scope_exit += [this]() { std::atomic_store(&ssl_context_, ssl_context_ptr_type()); ssl_enabled_ = false; };
+
+        // The TLS connections may run on a dedicated pool, so that the handshake bursts don't hold the io threads
+        const int tls_thread_count = ssl ? static_cast<int>(server_options_.ssl_handshake_threads) : 0;
+        std::unique_ptr<io_context_type> tls_ioc(tls_thread_count ? new io_context_type{ tls_thread_count } : nullptr);
+        std::vector<std::thread> tls_threads;
+        if (tls_ioc) {
+            tls_io_context_ = tls_ioc.get();
+            auto work_guard = std::make_shared<boost::asio::executor_work_guard<io_context_type::executor_type>>(tls_ioc->get_executor());
+            for (auto i = tls_thread_count; i > 0; --i)
+                tls_threads.emplace_back([&tls_ioc, work_guard]() { tls_ioc->run(); });
+        }
+        ssl_handshake_limiter_.set_limit(server_options_.ssl_handshake_concurrency, server_options_.ssl_handshake_max_waiting,
+                                         std::chrono::milliseconds(server_options_.ssl_handshake_wait_timeout));
+        if (server_options_.ssl_handshake_concurrency)
+            ssl_handshake_limiter_.start(ioc);
+        admission_controller_.set_limits(server_options_.max_connections, server_options_.max_connections_per_ip,
+                                         server_options_.overload_policy);
+        rate_limiter_.set_rules(server_options_.rate_limit_rules, server_options_.rate_limit_key_header, server_options_.rate_limit_max_buckets);
+        session_pool::set_cache_limit(server_options_.session_pool_cache_bytes);
+        handler_arena::set_enabled(server_options_.handler_arena && !server_options_.low_memory);
+
+        // The idle keep-alive connections are expired in bulk by a timer wheel per io_context of the connections
+        if (server_options_.http_read_phases()) {
+            std::vector<io_context_type*> contexts;
+            for (std::size_t i = 0; pool && i < pool->size(); ++i)
+                contexts.push_back(&pool->context(i));
+            if (!pool)
+                contexts.push_back(&ioc);
+            if (tls_ioc)
+                contexts.push_back(tls_ioc.get());
+            connection_reaper_.start(contexts, server_options_.http_max_idle_connections);
+        }
+        // The requests the event loop leaves unanswered are answered at their deadline, while the bridge is enabled
+        async_bridge_.start(ioc);
 
         // Create and launch a listening port
         handle_listen(ioc, port);
@@ -74,7 +117,7 @@ int app_resource::run_server(unsigned short port, bool ssl, int thread_count) {
         // Run the I / O service on the requested number of threads
         std::vector<std::thread> v;
         v.reserve(thread_count - 1);
-        for (auto i = thread_count - 1; i > 0; --i)
+        for (auto i = per_thread ? 0 : thread_count - 1; i > 0; --i)
             v.emplace_back([&ioc](){
                 ioc.run();
             });
@@ -85,6 +128,21 @@ int app_resource::run_server(unsigned short port, bool ssl, int thread_count) {
         // Block until all the threads exit
         for (auto& t : v)
             t.join();
+        if (tls_ioc)
+            tls_ioc->stop();
+        for (auto& t : tls_threads)
+            t.join();
+        if (pool) {
+            pool->stop();
+            pool->join();
+        }
+        ssl_handshake_limiter_.clear();
+        connection_reaper_.clear();
+        async_bridge_.clear();
+        tls_io_context_ = nullptr;
+        io_context_pool_ = nullptr;
+        pool.reset();
+        handle_unlisten();
     }
     return EXIT_SUCCESS;
 }
@@ -95,6 +153,26 @@ void app_resource::shutdown_server(void) {
     // `io_context` and all of the sockets in it.
     if (io_context_ && !io_context_->stopped())
         io_context_->stop();
+    if (tls_io_context_ && !tls_io_context_->stopped())
+        tls_io_context_->stop();
+    if (io_context_pool_)
+        io_context_pool_->stop();
+}
+
+bool app_resource::reload_ssl_context(void) {
+    if (!io_context_ || !ssl_enabled_)
+        return false;
+
+    // The certificate handlers are called on the calling thread, the running handshakes are not disturbed
+    bool success = false;
+    auto ssl_context = make_server_ssl_context(server_options_, &success);
+    if (!success) {
+        LOG(ERROR) << "app_resource.reload_ssl_context: the new context is incomplete, the current one is kept.";
+        return false;
+    }
+    std::atomic_store(&ssl_context_, ssl_context);
+    server_counters_.add(server_counters::ssl_context_reloads);
+    return true;
 }
 
 app_resource* app_resource_get_instance(void) {
@@ -105,10 +183,54 @@ scaffold_handles* scaffold_handles_get_instance(void) {
     return &(app_resource_get_instance()->scaffold_handles_get_instance());
 }
 
+async_bridge* async_bridge_get_instance(void) {
+    return &(app_resource_get_instance()->async_bridge_get_instance());
+}
+
+ws_connection_registry* ws_connection_registry_get_instance(void) {
+    return &(app_resource_get_instance()->ws_connection_registry_get_instance());
+}
+
+server_options* server_options_get_instance(void) {
+    return &(app_resource_get_instance()->server_options_get_instance());
+}
+
+server_counters* server_counters_get_instance(void) {
+    return &(app_resource_get_instance()->server_counters_get_instance());
+}
+
+ssl_ticket_keys* ssl_ticket_keys_get_instance(void) {
+    return &(app_resource_get_instance()->ssl_ticket_keys_get_instance());
+}
+
+ssl_handshake_limiter* ssl_handshake_limiter_get_instance(void) {
+    return &(app_resource_get_instance()->ssl_handshake_limiter_get_instance());
+}
+
+admission_controller* admission_controller_get_instance(void) {
+    return &(app_resource_get_instance()->admission_controller_get_instance());
+}
+
+rate_limiter* rate_limiter_get_instance(void) {
+    return &(app_resource_get_instance()->rate_limiter_get_instance());
+}
+
+connection_reaper* connection_reaper_get_instance(void) {
+    return &(app_resource_get_instance()->connection_reaper_get_instance());
+}
+
+io_context_pool* io_context_pool_get_instance(void) {
+    return app_resource_get_instance()->get_io_context_pool();
+}
+
+boost::asio::io_context* get_tls_io_context(void) {
+    return app_resource_get_instance()->get_tls_io_context();
+}
+
 boost::asio::io_context* get_io_context(void) {
     return app_resource_get_instance()->get_io_context();
 }
 
-boost::asio::ssl::context* get_ssl_context(void) {
+std::shared_ptr<boost::asio::ssl::context> get_ssl_context(void) {
     return app_resource_get_instance()->get_ssl_context();
 }
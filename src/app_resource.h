@@ -9,6 +9,16 @@
 #include <string>
 #include <boost/asio/ssl/context.hpp>
 #include "src/scaffold_handles.h"
+#include "src/admission_controller.h"
+#include "src/async_bridge.h"
+#include "src/connection_reaper.h"
+#include "src/io_context_pool.h"
+#include "src/rate_limiter.h"
+#include "src/server_counters.h"
+#include "src/server_options.h"
+#include "src/ssl_handshake_limiter.h"
+#include "src/ssl_session_cache.h"
+#include "src/ws_connection_registry.h"
 
 class app_resource {
  public:
@@ -16,6 +26,17 @@ class app_resource {
     typedef scaffold_handles                                    callback_handles_type;
     typedef boost::asio::io_context                             io_context_type;
     typedef boost::asio::ssl::context                           ssl_context_type;
+    typedef std::shared_ptr<ssl_context_type>                   ssl_context_ptr_type;
+    typedef async_bridge                                        async_bridge_type;
+    typedef ws_connection_registry                              ws_connection_registry_type;
+    typedef server_options                                      server_options_type;
+    typedef server_counters                                     server_counters_type;
+    typedef ssl_ticket_keys                                     ssl_ticket_keys_type;
+    typedef ssl_handshake_limiter                               ssl_handshake_limiter_type;
+    typedef io_context_pool                                     io_context_pool_type;
+    typedef admission_controller                                admission_controller_type;
+    typedef rate_limiter                                        rate_limiter_type;
+    typedef connection_reaper                                   connection_reaper_type;
 
  private:
     app_resource(void);
@@ -28,22 +49,53 @@ class app_resource {
     static void release_singleton_instance(void);
     callback_handles_type& scaffold_handles_get_instance(void) { return callback_handles_; }
     const callback_handles_type& scaffold_handles_get_instance(void) const { return callback_handles_; }
+    async_bridge_type& async_bridge_get_instance(void) { return async_bridge_; }
+    ws_connection_registry_type& ws_connection_registry_get_instance(void) { return ws_connection_registry_; }
+    server_options_type& server_options_get_instance(void) { return server_options_; }
+    server_counters_type& server_counters_get_instance(void) { return server_counters_; }
+    ssl_ticket_keys_type& ssl_ticket_keys_get_instance(void) { return ssl_ticket_keys_; }
+    ssl_handshake_limiter_type& ssl_handshake_limiter_get_instance(void) { return ssl_handshake_limiter_; }
+    admission_controller_type& admission_controller_get_instance(void) { return admission_controller_; }
+    rate_limiter_type& rate_limiter_get_instance(void) { return rate_limiter_; }
+    connection_reaper_type& connection_reaper_get_instance(void) { return connection_reaper_; }
     io_context_type* get_io_context(void) const { return io_context_; }
-    ssl_context_type* get_ssl_context(void) const { return ssl_context_; }
+    io_context_type* get_tls_io_context(void) const { return tls_io_context_; }
+    io_context_pool_type* get_io_context_pool(void) const { return io_context_pool_; }
+    ssl_context_ptr_type get_ssl_context(void) const { return std::atomic_load(&ssl_context_); }
+    bool ssl_enabled(void) const { return ssl_enabled_; }
 
  public:
      bool init(std::string* result_error);
      int run_server(unsigned short port, bool ssl, int thread_count);
      void shutdown_server(void);
+     bool reload_ssl_context(void);
 
  private:
      callback_handles_type                                       callback_handles_;
+     // The sessions held by the bridge release their admission ticket (and update the counters) when it's destroyed
+     server_counters_type                                        server_counters_;
+     admission_controller_type                                   admission_controller_;
+     async_bridge_type                                           async_bridge_;
+     ws_connection_registry_type                                 ws_connection_registry_;
+     server_options_type                                         server_options_;
+     ssl_ticket_keys_type                                        ssl_ticket_keys_;
+     ssl_handshake_limiter_type                                  ssl_handshake_limiter_;
+     rate_limiter_type                                           rate_limiter_;
+     // The sessions disarm their idle entry when they are destroyed with their io_context
+     connection_reaper_type                                      connection_reaper_;
      io_context_type*                                            io_context_;
-     ssl_context_type*                                           ssl_context_;
+     // The pool of the TLS connections, null if they run on the io threads
+     io_context_type*                                            tls_io_context_;
+     // The io_context per thread, null if the io threads share io_context_
+     io_context_pool_type*                                       io_context_pool_;
+     // The new handshakes use the latest context, the sessions keep the one they were created with
+     ssl_context_ptr_type                                        ssl_context_;
+     bool                                                        ssl_enabled_;
 };
 
 app_resource* app_resource_get_instance(void);
-boost::asio::ssl::context* get_ssl_context(void);
+std::shared_ptr<boost::asio::ssl::context> get_ssl_context(void);
 boost::asio::io_context* get_io_context(void);
+boost::asio::io_context* get_tls_io_context(void);
 
 #endif  // SRC_APP_RESOURCE_H_
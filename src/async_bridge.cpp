@@ -0,0 +1,297 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/async_bridge.h"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "base/memory_utils.hpp"
+#include "base/utils.h"
+#include "os_glue/os_glue.h"
+#include "src/server_counters.h"
+
+// The answer to the requests shed by the CoDel control, the clients retry
+static const char k_overloaded_response[] = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nRetry-After: 1\r\n\r\n";
+// The answer to the requests the loop didn't answer within their timeout
+static const char k_timeout_response[] = "HTTP/1.1 504 Gateway Timeout\r\nContent-Length: 0\r\n\r\n";
+
+async_bridge::async_bridge(void) : enabled_(false), event_fd_(-1), wakeup_handler_pair_(nullptr, 0), next_request_handle_(0),
+                                   codel_target_(0), codel_interval_(0), codel_policy_(CODEL_POLICY_LIFO), codel_overloaded_(false),
+                                   deadline_waiting_(false) {
+}
+
+async_bridge::~async_bridge(void) {
+    disable();
+}
+
+int async_bridge::enable(async_bridge_wakeup_handler_type wakeup_cb, uintptr_t user_data) {
+    lock_type lock(mutex_);
+    if (event_fd_ < 0)
+        event_fd_ = os_event_fd_create();
+    wakeup_handler_pair_ = std::make_pair(wakeup_cb, user_data);
+    enabled_.store(true, std::memory_order_release);
+    if (deadline_timer_ && !deadline_waiting_)
+        wait_deadlines();
+    LOG(INFO) << "async_bridge.enable(event fd: " << event_fd_ << ").";
+    return event_fd_;
+}
+
+void async_bridge::set_codel(uint32_t target_milliseconds, uint32_t interval_milliseconds, int policy) {
+    lock_type lock(mutex_);
+    codel_target_ = std::chrono::milliseconds(target_milliseconds);
+    codel_interval_ = std::chrono::milliseconds(interval_milliseconds);
+    codel_policy_ = policy;
+    codel_first_above_time_ = clock_type::time_point();
+    codel_overloaded_ = false;
+}
+
+void async_bridge::start(io_context_type& ioc) {
+    lock_type lock(mutex_);
+    deadline_timer_.reset(new boost::asio::steady_timer(ioc));
+    deadline_waiting_ = false;
+    if (enabled())
+        wait_deadlines();
+}
+
+void async_bridge::clear(void) {
+    lock_type lock(mutex_);
+    deadline_timer_.reset();
+    deadline_waiting_ = false;
+}
+
+void async_bridge::disable(void) {
+    std::unordered_map<uintptr_t, pending_request> pending_requests;
+    {
+        lock_type lock(mutex_);
+        enabled_.store(false, std::memory_order_release);
+        os_event_fd_close(event_fd_);
+        event_fd_ = -1;
+        wakeup_handler_pair_ = std::make_pair(nullptr, 0);
+        if (deadline_timer_)
+            deadline_timer_->cancel();
+        deadline_waiting_ = false;
+        events_.clear();
+        requests_.clear();
+        pending_requests.swap(pending_requests_);
+    }
+    // The sessions are released outside of the lock because their destructors may call back into the bridge
+}
+
+void async_bridge::push_http_request(session_type session, const char* head, const char* body, uint32_t body_size,
+                                     clock_type::duration timeout, response_handle_type response_handle) {
+    const auto now = clock_type::now();
+    event new_event{ ASYNC_EVENT_HTTP_REQUEST, 0, head, std::string(body, body + body_size), now };
+    wakeup_handler_pair_type wakeup_handler_pair(nullptr, 0);
+    bool shed = false;
+    {
+        lock_type lock(mutex_);
+        if (!enabled())
+            return;
+
+        // A queue which isn't drained is overloaded too: the oldest request has waited at least this long
+        if (codel_target_.count() && !requests_.empty() && now - requests_.front().queued_time >= codel_target_)
+            codel_update(now - requests_.front().queued_time, now);
+        // Once the loop has drained the queue, a request is let in: its wait tells whether the overload is over
+        shed = codel_overloaded_ && codel_policy_ == CODEL_POLICY_SHED && !requests_.empty();
+        if (!shed) {
+            new_event.handle = ++next_request_handle_;
+            pending_requests_.emplace(new_event.handle, pending_request{ session, response_handle, now + timeout, false });
+            wakeup_handler_pair = push_event(&requests_, std::move(new_event));
+        }
+    }
+    if (wakeup_handler_pair.first)
+        wakeup_handler_pair.first(wakeup_handler_pair.second);
+    if (shed)
+        respond_overloaded(std::vector<pending_request>{ pending_request{ session, response_handle, now, false } });
+}
+
+void async_bridge::push_ws_event(int event_type, uintptr_t connection_handle, const char* message, uint32_t message_size) {
+    event new_event{ event_type, connection_handle, std::string(), message ? std::string(message, message + message_size) : std::string(),
+                     clock_type::now() };
+    wakeup_handler_pair_type wakeup_handler_pair(nullptr, 0);
+    {
+        lock_type lock(mutex_);
+        if (!enabled())
+            return;
+        wakeup_handler_pair = push_event(&events_, std::move(new_event));
+    }
+    if (wakeup_handler_pair.first)
+        wakeup_handler_pair.first(wakeup_handler_pair.second);
+}
+
+uint32_t async_bridge::poll(async_event_handler_type handle_cb, uintptr_t user_data, uint32_t max_events) {
+    std::vector<event> events;
+    std::vector<pending_request> shed_requests;
+    wakeup_handler_pair_type wakeup_handler_pair(nullptr, 0);
+    {
+        lock_type lock(mutex_);
+        if (event_fd_ >= 0)
+            os_event_fd_reset(event_fd_);
+        const auto now = clock_type::now();
+        std::size_t count = max_events ? std::min<std::size_t>(max_events, events_.size()) : events_.size();
+        events.reserve(count);
+        std::move(events_.begin(), events_.begin() + count, std::back_inserter(events));
+        events_.erase(events_.begin(), events_.begin() + count);
+
+        if (codel_target_.count() && !requests_.empty()) {
+            // The oldest request tells how long the queue stands
+            codel_update(now - requests_.front().queued_time, now);
+            if (codel_overloaded_) {
+                while (!requests_.empty() && now - requests_.front().queued_time > codel_interval_) {
+                    shed_request(requests_.front().handle, &shed_requests);
+                    requests_.pop_front();
+                }
+            }
+        }
+
+        // Overloaded, the newest requests are served first: they are the most likely to be awaited still
+        count = max_events ? std::min<std::size_t>(max_events - events.size(), requests_.size()) : requests_.size();
+        const bool lifo = codel_overloaded_ && codel_policy_ == CODEL_POLICY_LIFO;
+        clock_type::duration sojourn(0);
+        std::size_t dispatched = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            event& request = lifo ? requests_.back() : requests_.front();
+            // A request answered at its deadline is dropped
+            auto it = pending_requests_.find(request.handle);
+            if (it != pending_requests_.end()) {
+                it->second.dispatched = true;
+                sojourn += now - request.queued_time;
+                events.emplace_back(std::move(request));
+                ++dispatched;
+            }
+            if (lifo)
+                requests_.pop_back();
+            else
+                requests_.pop_front();
+        }
+        count = dispatched;
+        if (count) {
+            server_counters_get_instance()->add(server_counters::dispatch_requests, count);
+            server_counters_get_instance()->add(server_counters::dispatch_sojourn_nanoseconds,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(sojourn).count());
+        }
+
+        // The loop only gets woken up on the empty -> non-empty transition, so wake it again for the leftovers
+        if (!events_.empty() || !requests_.empty())
+            wakeup_handler_pair = notify();
+    }
+    if (wakeup_handler_pair.first)
+        wakeup_handler_pair.first(wakeup_handler_pair.second);
+    respond_overloaded(shed_requests);
+
+    for (auto& item : events)
+        handle_cb(user_data, item.event_type, item.handle, item.head.data(), static_cast<uint32_t>(item.head.size()),
+                  item.body.data(), static_cast<uint32_t>(item.body.size()));
+    return static_cast<uint32_t>(events.size());
+}
+
+bool async_bridge::respond(uintptr_t request_handle, const char* response_content, uint32_t response_size) {
+    pending_request request;
+    {
+        lock_type lock(mutex_);
+        auto it = pending_requests_.find(request_handle);
+        if (it == pending_requests_.end())
+            return false;
+        request = std::move(it->second);
+        pending_requests_.erase(it);
+    }
+
+    // The session marshals the response onto its own strand
+    request.response_handle(object_handle_from_pointer(request.session), response_content, response_size);
+    return true;
+}
+
+// The caller must hold the lock, the timer only ticks while the bridge is enabled
+void async_bridge::wait_deadlines(void) {
+    // The timeouts are in seconds
+    deadline_waiting_ = true;
+    deadline_timer_->expires_after(std::chrono::seconds(1));
+    deadline_timer_->async_wait([this](boost::system::error_code ec) { on_deadline_tick(ec); });
+}
+
+void async_bridge::on_deadline_tick(boost::system::error_code ec) {
+    if (ec == boost::asio::error::operation_aborted)
+        return;
+
+    // The queued requests are answered with a 503, the dispatched ones with a 504: their handler failed or hangs
+    std::vector<pending_request> expired;
+    {
+        lock_type lock(mutex_);
+        const auto now = clock_type::now();
+        for (auto it = pending_requests_.begin(); it != pending_requests_.end();) {
+            if (now < it->second.deadline) {
+                ++it;
+                continue;
+            }
+            expired.emplace_back(std::move(it->second));
+            it = pending_requests_.erase(it);
+        }
+        if (enabled() && deadline_timer_)
+            wait_deadlines();
+        else
+            deadline_waiting_ = false;
+    }
+
+    if (!expired.empty())
+        server_counters_get_instance()->add(server_counters::dispatch_timeouts, expired.size());
+    for (const auto& request : expired) {
+        if (request.dispatched)
+            request.response_handle(object_handle_from_pointer(request.session), k_timeout_response, sizeof(k_timeout_response) - 1);
+        else
+            request.response_handle(object_handle_from_pointer(request.session), k_overloaded_response, sizeof(k_overloaded_response) - 1);
+    }
+}
+
+// The caller must hold the lock. The returned wakeup handler has to be called after the lock is released.
+async_bridge::wakeup_handler_pair_type async_bridge::push_event(std::deque<event>* queue, event&& new_event) {
+    const bool was_empty = events_.empty() && requests_.empty();
+    queue->emplace_back(std::move(new_event));
+    return was_empty ? notify() : wakeup_handler_pair_type(nullptr, 0);
+}
+
+// The caller must hold the lock.
+async_bridge::wakeup_handler_pair_type async_bridge::notify(void) {
+    if (event_fd_ >= 0) {
+        os_event_fd_notify(event_fd_);
+        return wakeup_handler_pair_type(nullptr, 0);
+    }
+    return wakeup_handler_pair_;
+}
+
+// The caller must hold the lock. The queue is overloaded once the requests have waited above the target for an interval,
+// and recovers with the first one below it.
+void async_bridge::codel_update(clock_type::duration sojourn, clock_type::time_point now) {
+    if (sojourn < codel_target_) {
+        codel_first_above_time_ = clock_type::time_point();
+        if (codel_overloaded_) {
+            LOG(INFO) << "async_bridge.codel: the request queue has recovered.";
+        }
+        codel_overloaded_ = false;
+    } else if (codel_first_above_time_ == clock_type::time_point()) {
+        codel_first_above_time_ = now + codel_interval_;
+    } else if (!codel_overloaded_ && now >= codel_first_above_time_) {
+        codel_overloaded_ = true;
+        server_counters_get_instance()->add(server_counters::dispatch_overloads);
+        LOG(WARNING) << "async_bridge.codel: the requests wait "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(sojourn).count() << " ms, the request queue is overloaded.";
+    }
+}
+
+// The caller must hold the lock.
+void async_bridge::shed_request(uintptr_t request_handle, std::vector<pending_request>* shed_requests) {
+    auto it = pending_requests_.find(request_handle);
+    if (it != pending_requests_.end()) {
+        shed_requests->emplace_back(std::move(it->second));
+        pending_requests_.erase(it);
+    }
+}
+
+// The sessions marshal the responses onto their own strand, it's called after the lock is released
+void async_bridge::respond_overloaded(const std::vector<pending_request>& shed_requests) {
+    if (!shed_requests.empty())
+        server_counters_get_instance()->add(server_counters::dispatch_shed, shed_requests.size());
+    for (const auto& request : shed_requests)
+        request.response_handle(object_handle_from_pointer(request.session), k_overloaded_response, sizeof(k_overloaded_response) - 1);
+}
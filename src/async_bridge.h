@@ -0,0 +1,120 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// The async bridge hands HTTP requests and WebSocket events over to a foreign event loop (python asyncio)
+// instead of calling the python handlers on the io threads:
+//
+//      io thread:      push_xxx(...)  --> queue --> notify event fd (or wakeup callback)
+//      event loop:     poll(...)      <-- queue, then answer with respond(request_handle, ...) from any thread
+//
+// The HTTP requests are under a CoDel-style control: when the time they wait in the queue stays above the target
+// for an interval, the queue is overloaded. Then the stale requests are answered with a 503, and the newest are
+// dispatched first (CODEL_POLICY_LIFO) or the new ones are answered with a 503 at once (CODEL_POLICY_SHED).
+//
+// A request which isn't answered within the request timeout of its session is answered natively: with a 503 if it's
+// still queued, with a 504 if the loop has it (its handler failed or hangs). The late answer of the loop is dropped.
+//
+
+#ifndef SRC_ASYNC_BRIDGE_H_
+#define SRC_ASYNC_BRIDGE_H_
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include "include/beast_utils.h"
+#include "base/memory_utils_base.hpp"
+
+class async_bridge {
+ public:
+    typedef async_bridge                                                    this_type;
+    typedef std::mutex                                                      mutex_type;
+    typedef std::unique_lock<mutex_type>                                    lock_type;
+    typedef std::shared_ptr<virtual_enable_shared_from_this_base>           session_type;
+    typedef std::function<void(uintptr_t, const char*, uint32_t)>           response_handle_type;
+    typedef std::pair<async_bridge_wakeup_handler_type, uintptr_t>          wakeup_handler_pair_type;
+    typedef std::chrono::steady_clock                                       clock_type;
+    typedef boost::asio::io_context                                         io_context_type;
+
+    struct event {
+        int                     event_type;
+        uintptr_t               handle;
+        std::string             head;
+        std::string             body;
+        clock_type::time_point  queued_time;
+    };
+
+    struct pending_request {
+        session_type            session;
+        response_handle_type    response_handle;
+        clock_type::time_point  deadline;
+        // Handed over to the loop by poll
+        bool                    dispatched;
+    };
+
+ public:
+    async_bridge(void);
+    ~async_bridge(void);
+    explicit async_bridge(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+ public:
+    int enable(async_bridge_wakeup_handler_type wakeup_cb, uintptr_t user_data);
+    void disable(void);
+    bool enabled(void) const { return enabled_.load(std::memory_order_acquire); }
+    // A target of 0 disables the control, policy: CODEL_POLICY_XXX
+    void set_codel(uint32_t target_milliseconds, uint32_t interval_milliseconds, int policy);
+    // The deadlines of the pending requests are checked on ioc while the bridge is enabled, clear must be called before
+    // it's destroyed
+    void start(io_context_type& ioc);
+    void clear(void);
+
+    void push_http_request(session_type session, const char* head, const char* body, uint32_t body_size, clock_type::duration timeout,
+                           response_handle_type response_handle);
+    void push_ws_event(int event_type, uintptr_t connection_handle, const char* message, uint32_t message_size);
+
+    uint32_t poll(async_event_handler_type handle_cb, uintptr_t user_data, uint32_t max_events);
+    bool respond(uintptr_t request_handle, const char* response_content, uint32_t response_size);
+
+ private:
+    wakeup_handler_pair_type push_event(std::deque<event>* queue, event&& new_event);
+    wakeup_handler_pair_type notify(void);
+    void codel_update(clock_type::duration sojourn, clock_type::time_point now);
+    void shed_request(uintptr_t request_handle, std::vector<pending_request>* shed_requests);
+    static void respond_overloaded(const std::vector<pending_request>& shed_requests);
+    void wait_deadlines(void);
+    void on_deadline_tick(boost::system::error_code ec);
+
+ private:
+    std::atomic<bool>                                       enabled_;
+    int                                                     event_fd_;
+    wakeup_handler_pair_type                                wakeup_handler_pair_;
+    mutex_type                                              mutex_;
+    std::deque<event>                                       events_;
+    // The HTTP requests are apart from the ws events, whose order matters
+    std::deque<event>                                       requests_;
+    std::unordered_map<uintptr_t, pending_request>          pending_requests_;
+    uintptr_t                                               next_request_handle_;
+    clock_type::duration                                    codel_target_;
+    clock_type::duration                                    codel_interval_;
+    int                                                     codel_policy_;
+    // The time the requests will have waited above the target for an interval, if they keep on
+    clock_type::time_point                                  codel_first_above_time_;
+    bool                                                    codel_overloaded_;
+    std::unique_ptr<boost::asio::steady_timer>              deadline_timer_;
+    // A tick of the deadline timer is pending
+    bool                                                    deadline_waiting_;
+};
+
+async_bridge* async_bridge_get_instance(void);
+
+#endif  // SRC_ASYNC_BRIDGE_H_
@@ -0,0 +1,172 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/connection_reaper.h"
+#include <algorithm>
+#include <utility>
+#include "src/server_counters.h"
+
+connection_reaper::timer_wheel::timer_wheel(io_context_type& ioc) : timer_(ioc), start_time_(clock_type::now()), current_tick_(0) {
+}
+
+void connection_reaper::timer_wheel::start(void) {
+    start_time_ = clock_type::now();
+    current_tick_ = 0;
+    wait();
+}
+
+void connection_reaper::timer_wheel::add(const std::shared_ptr<idle_connection>& connection, clock_type::duration timeout) {
+    const std::chrono::milliseconds tick(tick_milliseconds);
+    lock_type lock(mutex_);
+    // Rounded up: a connection is never expired before its timeout
+    const auto elapsed = clock_type::now() + timeout - start_time_;
+    const uint64_t expiry_tick = std::max<uint64_t>(current_tick_ + 1, static_cast<uint64_t>((elapsed + tick - clock_type::duration(1)) / tick));
+    connection->expiry_tick = expiry_tick;
+    insert(entry{ connection, ++connection->generation }, expiry_tick);
+}
+
+void connection_reaper::timer_wheel::wait(void) {
+    timer_.expires_at(start_time_ + std::chrono::milliseconds(tick_milliseconds) * (current_tick_ + 1));
+    timer_.async_wait([this](boost::system::error_code ec) { on_tick(ec); });
+}
+
+void connection_reaper::timer_wheel::on_tick(boost::system::error_code ec) {
+    if (ec == boost::asio::error::operation_aborted)
+        return;
+
+    // A late tick catches up with the clock
+    expired_list_type expired;
+    {
+        lock_type lock(mutex_);
+        const uint64_t now_tick = static_cast<uint64_t>((clock_type::now() - start_time_) / std::chrono::milliseconds(tick_milliseconds));
+        while (current_tick_ < now_tick)
+            advance(&expired);
+    }
+    wait();
+
+    if (!expired.empty())
+        server_counters_get_instance()->add(server_counters::http_idle_reaped, expired.size());
+    for (auto& expired_connection : expired)
+        expired_connection.first->expire_handle(expired_connection.second, false);
+}
+
+void connection_reaper::timer_wheel::insert(entry&& wheel_entry, uint64_t expiry_tick) {
+    const uint64_t mask = level_size - 1;
+    const uint64_t delta = expiry_tick - current_tick_;
+    if (delta < level_size)
+        return levels_[0][expiry_tick & mask].push_back(std::move(wheel_entry));
+
+    // Further than level 1 reaches, the entry is put in its last slot and inserted again from there
+    const uint64_t level_range = static_cast<uint64_t>(level_size - 1) * level_size;
+    const uint64_t slot_tick = delta < level_range ? expiry_tick : current_tick_ + level_range - 1;
+    levels_[1][(slot_tick >> level_bits) & mask].push_back(std::move(wheel_entry));
+}
+
+void connection_reaper::timer_wheel::advance(expired_list_type* expired) {
+    const uint64_t mask = level_size - 1;
+    ++current_tick_;
+
+    // At each turn of level 0, the next slot of level 1 is spread over it
+    if ((current_tick_ & mask) == 0) {
+        std::vector<entry> cascaded;
+        cascaded.swap(levels_[1][(current_tick_ >> level_bits) & mask]);
+        for (auto& wheel_entry : cascaded) {
+            auto connection = wheel_entry.connection.lock();
+            if (connection && connection->generation.load(std::memory_order_relaxed) == wheel_entry.generation)
+                insert(std::move(wheel_entry), std::max(connection->expiry_tick, current_tick_));
+        }
+    }
+
+    // The slot keeps its capacity for the next turn
+    auto& due = levels_[0][current_tick_ & mask];
+    for (auto& wheel_entry : due) {
+        auto connection = wheel_entry.connection.lock();
+        if (connection && connection->generation.load(std::memory_order_relaxed) == wheel_entry.generation)
+            expired->emplace_back(std::move(connection), wheel_entry.generation);
+    }
+    due.clear();
+}
+
+connection_reaper::connection_reaper(void) : max_idle_(0) {
+}
+
+connection_reaper::~connection_reaper(void) {
+}
+
+void connection_reaper::start(const std::vector<io_context_type*>& contexts, uint32_t max_idle) {
+    max_idle_ = max_idle;
+    for (auto ioc : contexts) {
+        auto& wheel = wheels_[ioc];
+        if (!wheel) {
+            wheel.reset(new timer_wheel(*ioc));
+            wheel->start();
+        }
+    }
+}
+
+void connection_reaper::clear(void) {
+    wheels_.clear();
+}
+
+std::shared_ptr<connection_reaper::idle_connection> connection_reaper::make_idle_connection(const boost::asio::execution_context& context,
+                                                                                               expire_handle_type expire_handle) {
+    auto it = wheels_.find(&context);
+    if (it == wheels_.end())
+        return nullptr;
+
+    auto connection = std::make_shared<idle_connection>();
+    connection->expire_handle = std::move(expire_handle);
+    connection->self = connection;
+    connection->wheel = it->second.get();
+    connection->generation.store(0, std::memory_order_relaxed);
+    connection->armed.store(false, std::memory_order_relaxed);
+    connection->expiry_tick = 0;
+    connection->listed = false;
+    return connection;
+}
+
+void connection_reaper::arm(const std::shared_ptr<idle_connection>& connection, clock_type::duration timeout) {
+    if (!connection->armed.exchange(true, std::memory_order_relaxed))
+        server_counters_get_instance()->add(server_counters::http_idle_connections);
+    connection->wheel->add(connection, timeout);
+    if (!max_idle_)
+        return;
+
+    // The oldest idle connection makes room for this one
+    std::shared_ptr<idle_connection> evicted;
+    uint64_t evicted_generation = 0;
+    {
+        lock_type lock(lru_mutex_);
+        if (connection->listed)
+            lru_.erase(connection->lru_position);
+        connection->lru_position = lru_.insert(lru_.end(), connection.get());
+        connection->listed = true;
+        if (lru_.size() > max_idle_) {
+            auto oldest = lru_.front();
+            lru_.pop_front();
+            oldest->listed = false;
+            evicted = oldest->self.lock();
+            evicted_generation = oldest->generation.load(std::memory_order_relaxed);
+        }
+    }
+    if (evicted) {
+        server_counters_get_instance()->add(server_counters::http_idle_evictions);
+        evicted->expire_handle(evicted_generation, true);
+    }
+}
+
+void connection_reaper::disarm(idle_connection& connection) {
+    // The entry left in the wheel is stale from now on
+    ++connection.generation;
+    if (connection.armed.exchange(false, std::memory_order_relaxed))
+        server_counters_get_instance()->sub(server_counters::http_idle_connections);
+    if (!max_idle_)
+        return;
+
+    lock_type lock(lru_mutex_);
+    if (connection.listed) {
+        lru_.erase(connection.lru_position);
+        connection.listed = false;
+    }
+}
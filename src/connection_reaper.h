@@ -0,0 +1,134 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Expires the idle keep-alive connections in bulk. Each io_context has a hierarchical timer wheel driven by a single
+// timer, instead of a timer per connection rearmed at every request:
+//
+//      arm(connection, timeout)    --> the slot of its tick, expire_handle(generation, false) once the tick is reached
+//      disarm(connection)          --> the generation changes, the stale entry is dropped when its slot is reached
+//
+// The idle connections are also kept in the order they went idle: over the cap, the oldest one is evicted with
+// expire_handle(generation, true).
+//
+
+#ifndef SRC_CONNECTION_REAPER_H_
+#define SRC_CONNECTION_REAPER_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <boost/asio/execution/context.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/query.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+class connection_reaper {
+ public:
+    typedef connection_reaper                                               this_type;
+    typedef std::mutex                                                      mutex_type;
+    typedef std::unique_lock<mutex_type>                                    lock_type;
+    typedef std::chrono::steady_clock                                       clock_type;
+    typedef boost::asio::io_context                                         io_context_type;
+    // It's called on the thread of a wheel, or on the one of the connection which made another one the oldest: the
+    // close should be posted to the executor of the session. evicted: by the cap rather than the timeout.
+    typedef std::function<void(uint64_t generation, bool evicted)>          expire_handle_type;
+
+    // A wheel turns by ticks, level 0 holds the next 256 ticks (25.6 s), level 1 the next 255 * 256 ticks (~109 min)
+    enum { tick_milliseconds = 100, level_bits = 8, level_size = 1 << level_bits };
+
+    class timer_wheel;
+    struct idle_connection;
+    typedef std::list<idle_connection*>                                     lru_list_type;
+
+    // Held by the session from its first idle wait
+    struct idle_connection {
+        expire_handle_type              expire_handle;
+        std::weak_ptr<idle_connection>  self;
+        timer_wheel*                    wheel;
+        // Changed by every arm and disarm: the entries of the older generations are stale
+        std::atomic<uint64_t>           generation;
+        std::atomic<bool>               armed;
+        // Guarded by the lock of the wheel
+        uint64_t                        expiry_tick;
+        // Guarded by the lock of the idle list, the session disarms the connection before it's destroyed
+        bool                            listed;
+        lru_list_type::iterator         lru_position;
+    };
+
+    class timer_wheel {
+     public:
+        explicit timer_wheel(io_context_type& ioc);
+        explicit timer_wheel(const timer_wheel&) = delete;
+        timer_wheel& operator=(const timer_wheel&) = delete;
+
+     public:
+        void start(void);
+        // A new generation of the connection expires after timeout
+        void add(const std::shared_ptr<idle_connection>& connection, clock_type::duration timeout);
+
+     private:
+        struct entry {
+            std::weak_ptr<idle_connection>  connection;
+            uint64_t                        generation;
+        };
+        typedef std::array<std::vector<entry>, level_size>                  level_type;
+        typedef std::vector<std::pair<std::shared_ptr<idle_connection>, uint64_t>>  expired_list_type;
+
+        void wait(void);
+        void on_tick(boost::system::error_code ec);
+        // The caller must hold the lock
+        void insert(entry&& wheel_entry, uint64_t expiry_tick);
+        void advance(expired_list_type* expired);
+
+     private:
+        mutex_type                      mutex_;
+        boost::asio::steady_timer       timer_;
+        clock_type::time_point          start_time_;
+        uint64_t                        current_tick_;
+        std::array<level_type, 2>       levels_;
+    };
+
+ public:
+    connection_reaper(void);
+    ~connection_reaper(void);
+    explicit connection_reaper(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+ public:
+    // A wheel per io_context of the connections, max_idle: the cap of the idle connections (0: unlimited)
+    void start(const std::vector<io_context_type*>& contexts, uint32_t max_idle);
+    // Drop the wheels, it must be called before their io_context is destroyed
+    void clear(void);
+    // Null if the context has no wheel: the session keeps the timer of its stream
+    std::shared_ptr<idle_connection> make_idle_connection(const boost::asio::execution_context& context, expire_handle_type expire_handle);
+    void arm(const std::shared_ptr<idle_connection>& connection, clock_type::duration timeout);
+    // It's called on the executor of the session, when the connection is busy again or closed
+    void disarm(idle_connection& connection);
+
+ private:
+    std::unordered_map<const boost::asio::execution_context*, std::unique_ptr<timer_wheel>>     wheels_;
+    uint32_t                                    max_idle_;
+    mutex_type                                  lru_mutex_;
+    lru_list_type                               lru_;
+};
+
+connection_reaper* connection_reaper_get_instance(void);
+
+// The idle entry of a connection on the io_context of executor
+template<class Executor>
+std::shared_ptr<connection_reaper::idle_connection> make_idle_connection(const Executor& executor,
+                                                                           connection_reaper::expire_handle_type expire_handle) {
+    return connection_reaper_get_instance()->make_idle_connection(boost::asio::query(executor, boost::asio::execution::context),
+                                                                  std::move(expire_handle));
+}
+
+#endif  // SRC_CONNECTION_REAPER_H_
@@ -0,0 +1,68 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/handler_arena.h"
+#include <new>
+#include "src/server_counters.h"
+#include "src/session_pool.h"
+
+// The slots of an arena, freed by the last of the arena and the operations in them
+struct handler_arena::slot_block {
+    typedef typename std::aligned_storage<slot_size, alignof(std::max_align_t)>::type  slot_type;
+
+    slot_block(void) noexcept : references(1) { for (auto& slot_in_use : in_use) slot_in_use.store(false, std::memory_order_relaxed); }
+
+    slot_type                   slots[slot_count];
+    std::atomic<bool>           in_use[slot_count];
+    std::atomic<uint32_t>       references;
+};
+
+std::atomic<bool> handler_arena::enabled_(true);
+
+handler_arena::handler_arena(void) : block_(nullptr) {
+    if (enabled_.load(std::memory_order_relaxed))
+        block_ = new (session_pool::allocate(sizeof(slot_block))) slot_block();
+}
+
+handler_arena::~handler_arena(void) {
+    if (block_)
+        release(block_);
+}
+
+std::size_t handler_arena::memory_bytes(void) const {
+    return block_ ? session_pool::block_size(sizeof(slot_block)) : 0;
+}
+
+void handler_arena::set_enabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void* handler_arena::allocate(slot_block* block, std::size_t size) {
+    if (block && size <= slot_size) {
+        for (int index = 0; index < slot_count; ++index) {
+            if (!block->in_use[index].exchange(true, std::memory_order_acquire)) {
+                block->references.fetch_add(1, std::memory_order_relaxed);
+                server_counters::add_thread_local(server_counters::handler_arena_hits);
+                return &block->slots[index];
+            }
+        }
+    }
+    server_counters::add_thread_local(server_counters::handler_arena_misses);
+    return session_pool::allocate(size);
+}
+
+void handler_arena::deallocate(slot_block* block, void* p, std::size_t size) noexcept {
+    if (block && p >= static_cast<void*>(block->slots) && p < static_cast<void*>(block->slots + slot_count)) {
+        block->in_use[static_cast<slot_block::slot_type*>(p) - block->slots].store(false, std::memory_order_release);
+        return release(block);
+    }
+    session_pool::deallocate(p, size);
+}
+
+void handler_arena::release(slot_block* block) noexcept {
+    if (block->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        block->~slot_block();
+        session_pool::deallocate(block, sizeof(slot_block));
+    }
+}
@@ -0,0 +1,126 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Recycles the memory of the async operations of a session. asio allocates the state of an operation with the
+// allocator associated with its completion handler, the handlers of a session draw it from a few slots of the session:
+//
+//      async_read(stream, buffer, make_arena_handler(arena_, handler))    --> the operation is held by a free slot
+//
+// A larger operation, or one started while the slots are taken, falls back to the session pool. An operation is freed
+// before its handler is called, possibly off the strand of the session: the slots are claimed atomically.
+//
+// The slots are a block of their own, held by the arena and by each operation in them: asio destroys an operation,
+// whose handler may hold the last reference to the session, before it frees its memory.
+//
+
+#ifndef SRC_HANDLER_ARENA_H_
+#define SRC_HANDLER_ARENA_H_
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/detail/handler_cont_helpers.hpp>
+
+class handler_arena {
+ public:
+    typedef handler_arena                                                   this_type;
+    // A read, a write and a dispatch of a response in flight together, an HTTP read through a tcp_stream takes ~700 bytes
+    enum { slot_count = 3, slot_size = 768 };
+
+    struct slot_block;
+
+ public:
+    // Null while the arena is off: the session pool serves all the operations
+    handler_arena(void);
+    ~handler_arena(void);
+    explicit handler_arena(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+ public:
+    slot_block* block(void) const noexcept { return block_; }
+    // The bytes of the slots held by the session
+    std::size_t memory_bytes(void) const;
+    // Off: the operations are allocated by the session pool only
+    static void set_enabled(bool enabled);
+    // The session pool serves the larger blocks, and all of them while the arena is off or full. The handlers of an
+    // operation hold its session: the block is alive when it's allocated, and each operation in it holds it.
+    static void* allocate(slot_block* block, std::size_t size);
+    static void deallocate(slot_block* block, void* p, std::size_t size) noexcept;
+
+ private:
+    static void release(slot_block* block) noexcept;
+
+ private:
+    static std::atomic<bool>    enabled_;
+    slot_block*                 block_;
+};
+
+template<class T>
+class handler_allocator {
+ public:
+    typedef T                                                               value_type;
+    typedef handler_arena::slot_block                                       slot_block;
+
+ public:
+    explicit handler_allocator(slot_block* block) noexcept : block_(block) {}
+    template<class U> handler_allocator(const handler_allocator<U>& other) noexcept : block_(other.block()) {}
+
+ public:
+    slot_block* block(void) const noexcept { return block_; }
+    T* allocate(std::size_t n) { return static_cast<T*>(handler_arena::allocate(block_, n * sizeof(T))); }
+    void deallocate(T* p, std::size_t n) noexcept { handler_arena::deallocate(block_, p, n * sizeof(T)); }
+    template<class U> bool operator==(const handler_allocator<U>& other) const noexcept { return block_ == other.block(); }
+    template<class U> bool operator!=(const handler_allocator<U>& other) const noexcept { return block_ != other.block(); }
+
+ private:
+    slot_block*                 block_;
+};
+
+// A completion handler with the allocator of its session, the executor of the wrapped handler is kept
+template<class Handler>
+class arena_handler {
+ public:
+    typedef handler_allocator<void>                                         allocator_type;
+
+ public:
+    arena_handler(handler_arena::slot_block* block, Handler handler) : block_(block), handler_(std::move(handler)) {}
+
+ public:
+    allocator_type get_allocator(void) const noexcept { return allocator_type(block_); }
+    const Handler& handler(void) const noexcept { return handler_; }
+    template<class... Args>
+    void operator()(Args&&... args) { handler_(std::forward<Args>(args)...); }
+
+    friend bool asio_handler_is_continuation(arena_handler* self) {
+        return boost_asio_handler_cont_helpers::is_continuation(self->handler_);
+    }
+
+ private:
+    handler_arena::slot_block*  block_;
+    Handler                     handler_;
+};
+
+template<class Handler>
+arena_handler<typename std::decay<Handler>::type> make_arena_handler(handler_arena& arena, Handler&& handler) {
+    return arena_handler<typename std::decay<Handler>::type>(arena.block(), std::forward<Handler>(handler));
+}
+
+namespace boost {
+namespace asio {
+
+template<class Handler, class Executor>
+struct associated_executor<arena_handler<Handler>, Executor> {
+    typedef typename associated_executor<Handler, Executor>::type          type;
+    static type get(const arena_handler<Handler>& handler, const Executor& executor = Executor()) noexcept {
+        return associated_executor<Handler, Executor>::get(handler.handler(), executor);
+    }
+};
+
+}  // namespace asio
+}  // namespace boost
+
+#endif  // SRC_HANDLER_ARENA_H_
@@ -0,0 +1,72 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/io_context_pool.h"
+#include <algorithm>
+#include "base/utils.h"
+#include "include/beast_utils.h"
+#include "os_glue/os_glue.h"
+
+io_context_pool::io_context_pool(std::size_t size, int distribution) : distribution_(distribution), next_index_(0) {
+    slots_.reserve(std::max<std::size_t>(1, size));
+    for (std::size_t i = std::max<std::size_t>(1, size); i > 0; --i)
+        slots_.emplace_back(new slot());
+}
+
+io_context_pool::~io_context_pool(void) {
+    stop();
+    join();
+}
+
+void io_context_pool::run(const std::vector<int>& cpus) {
+    threads_.reserve(slots_.size());
+    for (std::size_t i = 0; i < slots_.size(); ++i) {
+        const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        auto& ioc = slots_[i]->ioc;
+        threads_.emplace_back([&ioc, cpu]() {
+            if (cpu >= 0 && !os_set_thread_affinity(cpu)) {
+                LOG(WARNING) << "io_context_pool: the thread can't be pinned to the cpu " << cpu << ".";
+            }
+            ioc.run();
+        });
+    }
+}
+
+void io_context_pool::stop(void) {
+    for (auto& sp_slot : slots_)
+        sp_slot->ioc.stop();
+}
+
+void io_context_pool::join(void) {
+    for (auto& t : threads_)
+        t.join();
+    threads_.clear();
+}
+
+io_context_pool::io_context_type& io_context_pool::next(void) {
+    if (distribution_ == IO_DISTRIBUTION_LEAST_LOADED) {
+        // The ties go round-robin, so that an idle server spreads its first connections
+        const std::size_t first = next_index_.fetch_add(1, std::memory_order_relaxed);
+        std::size_t best = first % slots_.size();
+        for (std::size_t i = 1; i < slots_.size(); ++i) {
+            const std::size_t index = (first + i) % slots_.size();
+            if (connections(index) < connections(best))
+                best = index;
+        }
+        return slots_[best]->ioc;
+    }
+    return slots_[next_index_.fetch_add(1, std::memory_order_relaxed) % slots_.size()]->ioc;
+}
+
+io_context_pool::load_ticket_type io_context_pool::make_load_ticket(const boost::asio::execution_context& context) {
+    for (auto& sp_slot : slots_) {
+        if (&sp_slot->ioc == &context) {
+            sp_slot->connections.fetch_add(1, std::memory_order_relaxed);
+            return load_ticket_type(static_cast<void*>(sp_slot.get()), [](void* p) {
+                static_cast<slot*>(p)->connections.fetch_sub(1, std::memory_order_relaxed);
+            });
+        }
+    }
+    return nullptr;
+}
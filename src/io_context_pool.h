@@ -0,0 +1,77 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// One io_context per thread: a connection is accepted on one of them and all its handlers run on that thread.
+// The connections hold a load ticket of their io_context, the least loaded one has the fewest tickets:
+//
+//      listener --> next() --> io_context[i] <-- make_load_ticket(): connections[i] + 1 until the session is destroyed
+//
+
+#ifndef SRC_IO_CONTEXT_POOL_H_
+#define SRC_IO_CONTEXT_POOL_H_
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/execution/context.hpp>
+#include <boost/asio/query.hpp>
+
+class io_context_pool {
+ public:
+    typedef io_context_pool                                                 this_type;
+    typedef boost::asio::io_context                                         io_context_type;
+    typedef boost::asio::executor_work_guard<io_context_type::executor_type> work_guard_type;
+    typedef std::shared_ptr<void>                                           load_ticket_type;
+
+    struct slot {
+        // The sessions destroyed with the io_context still release their ticket
+        explicit slot(void) : connections(0), ioc(1), work_guard(ioc.get_executor()) {}
+        std::atomic<std::size_t>        connections;
+        io_context_type                 ioc;
+        work_guard_type                 work_guard;
+    };
+
+ public:
+    // distribution: IO_DISTRIBUTION_XXX
+    io_context_pool(std::size_t size, int distribution);
+    ~io_context_pool(void);
+    explicit io_context_pool(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+ public:
+    // Start a thread per io_context, the thread i is pinned to cpus[i % cpus.size()] (no pinning if empty)
+    void run(const std::vector<int>& cpus);
+    void stop(void);
+    void join(void);
+
+    // The io_context of the next connection
+    io_context_type& next(void);
+    // An empty ticket if the context isn't in the pool
+    load_ticket_type make_load_ticket(const boost::asio::execution_context& context);
+    std::size_t size(void) const { return slots_.size(); }
+    io_context_type& context(std::size_t index) { return slots_[index]->ioc; }
+    std::size_t connections(std::size_t index) const { return slots_[index]->connections.load(std::memory_order_relaxed); }
+
+ private:
+    int                                     distribution_;
+    std::vector<std::unique_ptr<slot>>      slots_;
+    std::vector<std::thread>                threads_;
+    std::atomic<std::size_t>                next_index_;
+};
+
+// Null if the server doesn't run an io_context per thread
+io_context_pool* io_context_pool_get_instance(void);
+
+// The load ticket of the io_context of a connection, it is held by the session
+template<class Executor>
+io_context_pool::load_ticket_type make_io_load_ticket(const Executor& executor) {
+    auto pool = io_context_pool_get_instance();
+    return pool ? pool->make_load_ticket(boost::asio::query(executor, boost::asio::execution::context)) : nullptr;
+}
+
+#endif  // SRC_IO_CONTEXT_POOL_H_
@@ -0,0 +1,103 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/rate_limiter.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include "src/server_counters.h"
+
+rate_limiter::rate_limiter(void) : max_shard_buckets_(0) {
+}
+
+rate_limiter::~rate_limiter(void) {
+}
+
+void rate_limiter::set_rules(const rules_type& rules, const std::string& key_header, std::size_t max_buckets) {
+    rules_.clear();
+    for (const auto& rule : rules) {
+        if (rule.rate > 0 && rule.burst > 0)
+            rules_.push_back(rule);
+    }
+    key_header_ = key_header;
+    max_shard_buckets_ = max_buckets ? std::max<std::size_t>(1, max_buckets / shard_count) : 0;
+}
+
+bool rate_limiter::admit(string_view_type target, string_view_type client_address, string_view_type client_key, uint32_t* retry_after_seconds) {
+    std::size_t rule_index = 0;
+    const auto rule = find_rule(target, &rule_index);
+    if (!rule)
+        return true;
+
+    // The rule is a part of the key: a client has a bucket per rule
+    std::string key(client_address.data(), client_address.size());
+    key.push_back('\0');
+    key.append(client_key.data(), client_key.size());
+    key.push_back('\0');
+    key.append(std::to_string(rule_index));
+    auto& bucket_shard = shards_[std::hash<std::string>()(key) % shard_count];
+
+    const auto now = clock_type::now();
+    const auto refill_time = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(rule->burst / rule->rate));
+    lock_type lock(bucket_shard.mutex);
+    if (now - bucket_shard.last_sweep >= std::chrono::milliseconds(sweep_interval_milliseconds))
+        sweep(bucket_shard, now);
+
+    auto it = bucket_shard.buckets.find(key);
+    if (it == bucket_shard.buckets.end()) {
+        // At the cap, the idle buckets are evicted first
+        if (max_shard_buckets_ && bucket_shard.buckets.size() >= max_shard_buckets_)
+            sweep(bucket_shard, now);
+        if (max_shard_buckets_ && bucket_shard.buckets.size() >= max_shard_buckets_) {
+            server_counters_get_instance()->add(server_counters::rate_limit_buckets_full);
+            if (retry_after_seconds)
+                *retry_after_seconds = 1;
+            return false;
+        }
+        it = bucket_shard.buckets.emplace(std::move(key), bucket{ static_cast<double>(rule->burst), now, now }).first;
+        server_counters_get_instance()->add(server_counters::rate_limit_buckets);
+    }
+    auto& client_bucket = it->second;
+    const double elapsed = std::chrono::duration<double>(now - client_bucket.last_time).count();
+    client_bucket.tokens = std::min<double>(rule->burst, client_bucket.tokens + elapsed * rule->rate);
+    client_bucket.last_time = now;
+    if (client_bucket.tokens < 1) {
+        if (retry_after_seconds)
+            *retry_after_seconds = static_cast<uint32_t>(std::ceil((1 - client_bucket.tokens) / rule->rate));
+        return false;
+    }
+    client_bucket.tokens -= 1;
+    client_bucket.idle_time = now + std::chrono::duration_cast<clock_type::duration>(
+        std::chrono::duration<double>((rule->burst - client_bucket.tokens) / rule->rate));
+    return true;
+}
+
+// The rule of the longest matching prefix
+const server_rate_rule* rate_limiter::find_rule(string_view_type target, std::size_t* rule_index) const {
+    const server_rate_rule* result = nullptr;
+    for (std::size_t i = 0; i < rules_.size(); ++i) {
+        const auto& prefix = rules_[i].prefix;
+        if (target.starts_with(string_view_type(prefix)) && (!result || prefix.size() > result->prefix.size())) {
+            result = &rules_[i];
+            *rule_index = i;
+        }
+    }
+    return result;
+}
+
+// The caller must hold the lock of the shard
+void rate_limiter::sweep(shard& bucket_shard, clock_type::time_point now) {
+    bucket_shard.last_sweep = now;
+    std::size_t erased = 0;
+    for (auto it = bucket_shard.buckets.begin(); it != bucket_shard.buckets.end();) {
+        if (it->second.idle_time <= now) {
+            it = bucket_shard.buckets.erase(it);
+            ++erased;
+        } else {
+            ++it;
+        }
+    }
+    if (erased)
+        server_counters_get_instance()->sub(server_counters::rate_limit_buckets, erased);
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Token buckets per client and per route prefix. A request or a WebSocket message takes a token from the bucket of
+// its client (the address, and the value of a header if any) for the longest matching prefix, the routes without a
+// rule are unlimited:
+//
+//      admit("/api/items?id=1", "203.0.113.7", "", &retry_after) --> false: over the limit, answered with a 429
+//
+// The buckets are spread over shards with a lock each, a bucket which has been idle long enough to be full again is
+// evicted: it would be recreated as is. The header is chosen by the client: the address stays a part of the key, so
+// a client can't get a fresh burst elsewhere by changing it, and the count of the buckets is capped.
+//
+
+#ifndef SRC_RATE_LIMITER_H_
+#define SRC_RATE_LIMITER_H_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/beast/core/string.hpp>
+#include "src/server_options.h"
+
+class rate_limiter {
+ public:
+    typedef rate_limiter                                                    this_type;
+    typedef std::mutex                                                      mutex_type;
+    typedef std::unique_lock<mutex_type>                                    lock_type;
+    typedef std::chrono::steady_clock                                       clock_type;
+    typedef boost::beast::string_view                                       string_view_type;
+    typedef std::vector<server_rate_rule>                                   rules_type;
+
+    // The shards are swept for idle buckets at most once per interval
+    enum { shard_count = 16, sweep_interval_milliseconds = 1000 };
+
+    struct bucket {
+        double                      tokens;
+        clock_type::time_point      last_time;
+        // The bucket is full again from then on
+        clock_type::time_point      idle_time;
+    };
+
+    struct shard {
+        mutex_type                                      mutex;
+        std::unordered_map<std::string, bucket>         buckets;
+        clock_type::time_point                          last_sweep;
+    };
+
+ public:
+    rate_limiter(void);
+    ~rate_limiter(void);
+    explicit rate_limiter(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+ public:
+    // The buckets are keyed by the client address and the value of key_header, max_buckets: 0 means unlimited
+    void set_rules(const rules_type& rules, const std::string& key_header, std::size_t max_buckets);
+    bool enabled(void) const { return !rules_.empty(); }
+    const std::string& key_header(void) const { return key_header_; }
+    // client_key: the value of key_header, empty if it's missing. retry_after_seconds: when the next token is available,
+    // if the request isn't admitted. A new client is refused while the buckets are at their cap.
+    bool admit(string_view_type target, string_view_type client_address, string_view_type client_key, uint32_t* retry_after_seconds);
+
+ private:
+    const server_rate_rule* find_rule(string_view_type target, std::size_t* rule_index) const;
+    void sweep(shard& bucket_shard, clock_type::time_point now);
+
+ private:
+    rules_type                                  rules_;
+    std::string                                 key_header_;
+    // The cap of the buckets of a shard
+    std::size_t                                 max_shard_buckets_;
+    std::array<shard, shard_count>              shards_;
+};
+
+rate_limiter* rate_limiter_get_instance(void);
+
+#endif  // SRC_RATE_LIMITER_H_
@@ -3,13 +3,23 @@
 // found in the LICENSE file.
 
 #include "src/scaffold_handles.h"
+#include <array>
 #include <limits>
 #include <memory>
 #include "net/http_session_plain.h"
 #include "net/http_session_ssl.h"
+#include "net/http_session_unix.h"
 #include "net/listener.h"
 #include "net/detect_session.h"
+#include "net/net_utils.h"
+#include "net/socket_options.h"
 #include "src/app_resource.h"
+#include "src/async_bridge.h"
+#include "src/session_pool.h"
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 uint32_t handle_http_body_limit(std::shared_ptr<virtual_enable_shared_from_this_base> sp_session) {
     uint32_t body_limit = std::numeric_limits<std::uint32_t>::max();
@@ -53,6 +63,11 @@ class http_response_wrapper {
 
 void handle_http_request(std::shared_ptr<virtual_enable_shared_from_this_base> sp_session, const char* head, const char* body, uint32_t body_size,
     std::function<void(uintptr_t, const char*, uint32_t)> response_cb) {
+    auto bridge = async_bridge_get_instance();
+    if (bridge->enabled())
+        return bridge->push_http_request(sp_session, head, body, body_size, std::chrono::seconds(handle_http_timeout_seconds(sp_session)),
+                                         response_cb);
+
     auto handle_pair = scaffold_handles_get_instance()->http_handler_pair;
     if (handle_pair.first) {
         http_response_wrapper my_class(sp_session, response_cb);
@@ -60,59 +75,306 @@ void handle_http_request(std::shared_ptr<virtual_enable_shared_from_this_base> s
     }
 }
 
-void handle_ws_connection_open(std::shared_ptr<virtual_enable_shared_from_this_base> sp_ws_connection) {
+void handle_ws_connection_open(uintptr_t connection_handle) {
+    auto bridge = async_bridge_get_instance();
+    if (bridge->enabled())
+        return bridge->push_ws_event(ASYNC_EVENT_WS_OPEN, connection_handle, nullptr, 0);
+
     auto handle_pair = scaffold_handles_get_instance()->ws_open_handler_pair;
     if (handle_pair.first)
-        handle_pair.first(handle_pair.second, reinterpret_cast<uintptr_t>(sp_ws_connection.get()));
+        handle_pair.first(handle_pair.second, connection_handle);
 }
 
-void handle_ws_connection_close(virtual_enable_shared_from_this_base* ws_connection) {
+void handle_ws_connection_close(uintptr_t connection_handle) {
+    auto bridge = async_bridge_get_instance();
+    if (bridge->enabled())
+        return bridge->push_ws_event(ASYNC_EVENT_WS_CLOSE, connection_handle, nullptr, 0);
+
     auto handle_pair = scaffold_handles_get_instance()->ws_close_handler_pair;
     if (handle_pair.first)
-        handle_pair.first(handle_pair.second, reinterpret_cast<uintptr_t>(ws_connection));
+        handle_pair.first(handle_pair.second, connection_handle);
 }
 
-void handle_ws_message(std::shared_ptr<virtual_enable_shared_from_this_base> sp_ws_connection, const char* message) {
+void handle_ws_message(uintptr_t connection_handle, const char* message, std::size_t message_size, bool binary) {
+    auto bridge = async_bridge_get_instance();
+    if (bridge->enabled())
+        return bridge->push_ws_event(binary ? ASYNC_EVENT_WS_BINARY_MESSAGE : ASYNC_EVENT_WS_MESSAGE, connection_handle, message,
+                                     static_cast<uint32_t>(message_size));
+
+    auto data_handle_pair = scaffold_handles_get_instance()->ws_data_message_handler_pair;
+    if (data_handle_pair.first)
+        return data_handle_pair.first(data_handle_pair.second, connection_handle, message, static_cast<uint32_t>(message_size),
+                                      binary ? WS_OPCODE_BINARY : WS_OPCODE_TEXT);
+
+    // The legacy handler gets a NUL-terminated copy
     auto handle_pair = scaffold_handles_get_instance()->ws_message_handler_pair;
     if (handle_pair.first)
-        handle_pair.first(handle_pair.second, reinterpret_cast<uintptr_t>(sp_ws_connection.get()), message);
-}
-
-void ws_connection_send(std::shared_ptr<virtual_enable_shared_from_this_base> sp_connection, const char* message) {
-    if (sp_connection) {
-        typedef plain_websocket_session plain_session_type;
-        typedef ssl_websocket_session ssl_session_type;
-        auto* ws_session = sp_connection.get();
-        plain_session_type* plain_session = dynamic_cast<plain_session_type*>(ws_session);
-        if (plain_session) {
-            plain_session->send(message);
-        } else {
-            ssl_session_type* ssl_session = dynamic_cast<ssl_session_type*>(ws_session);
-            if (ssl_session)
-                ssl_session->send(message);
-        }
+        handle_pair.first(handle_pair.second, connection_handle, std::string(message, message + message_size).c_str());
+}
+
+void handle_ws_chunk(uintptr_t connection_handle, const char* chunk, std::size_t chunk_size, bool binary, bool is_final) {
+    auto handle_pair = scaffold_handles_get_instance()->ws_chunk_handler_pair;
+    if (handle_pair.first)
+        handle_pair.first(handle_pair.second, connection_handle, chunk, static_cast<uint32_t>(chunk_size), binary ? WS_OPCODE_BINARY : WS_OPCODE_TEXT,
+                          is_final);
+}
+
+bool ws_send_message(uintptr_t connection_handle, const char* message) {
+    return ws_send_message(connection_handle, std::make_shared<const std::string>(message));
+}
+
+bool ws_send_message(uintptr_t connection_handle, std::shared_ptr<const std::string> sp_message, const std::string& key, bool binary) {
+    // A closed connection (or a stale handle) simply isn't found
+    auto session = ws_connection_registry_get_instance()->find_session(connection_handle);
+    if (!session)
+        return false;
+    session.send(std::move(sp_message), key, binary);
+    return true;
+}
+
+int64_t ws_queued_bytes(uintptr_t connection_handle) {
+    auto session = ws_connection_registry_get_instance()->find_session(connection_handle);
+    return session ? static_cast<int64_t>(session.queued_bytes()) : -1;
+}
+
+int64_t ws_memory_bytes(uintptr_t connection_handle) {
+    auto session = ws_connection_registry_get_instance()->find_session(connection_handle);
+    return session ? static_cast<int64_t>(session.memory_bytes()) : -1;
+}
+
+uint32_t ws_broadcast_message(const std::string& topic, std::shared_ptr<const std::string> sp_message, uintptr_t exclude_handle, bool binary) {
+    ws_connection_registry::handles_type handles;
+    ws_connection_registry_get_instance()->collect(topic, exclude_handle, &handles);
+
+    // The recipients are sent to in one pass on the calling thread: each send is dispatched to the strand of its session,
+    // so the broadcasts of a thread reach every connection in the order they were made
+    for (auto handle : handles)
+        ws_send_message(handle, sp_message, std::string(), binary);
+    return static_cast<uint32_t>(handles.size());
+}
+
+// Move a connected socket to another io_context, the socket is returned as is if it can't be released (Windows)
+static boost::asio::ip::tcp::socket move_socket(boost::asio::ip::tcp::socket&& socket, boost::asio::io_context& ioc,
+                                                boost::beast::error_code& ec) {
+    const auto protocol = socket.local_endpoint(ec).protocol();
+    const auto native_socket = ec ? socket.native_handle() : socket.release(ec);
+    if (ec) {
+        ec = {};
+        return std::move(socket);
     }
+    boost::asio::ip::tcp::socket moved_socket(ioc);
+    moved_socket.assign(protocol, native_socket, ec);
+    return moved_socket;
 }
 
 // this handle will be called when DetectSession parsed the request of client's connection
-void handle_ssl_detect(bool ssl, boost::beast::tcp_stream&& stream, boost::beast::flat_buffer&& buffer) {
+void handle_ssl_detect(bool ssl, boost::beast::tcp_stream&& stream, session_buffer_type&& buffer, std::shared_ptr<void> admission_ticket) {
     if (ssl) {
-        std::make_shared<ssl_http_session>(std::move(stream), get_ssl_context(), std::move(buffer),
-                                     handle_http_body_limit, handle_http_timeout_seconds, handle_http_request)->run();
+        // Move the connection to the TLS pool. It stays there for its lifetime: an established ssl stream can't change its
+        // executor, so the records are encrypted and decrypted by the TLS threads too.
+        auto socket = stream.release_socket();
+        auto tls_ioc = get_tls_io_context();
+        if (tls_ioc) {
+            boost::beast::error_code ec;
+            socket = move_socket(std::move(socket), *tls_ioc, ec);
+            if (ec)
+                return handle_error(ec, "handle_ssl_detect.move_socket");
+        }
+
+        // The handshake waits for a permit if too many are running, a refused one is closed with its session
+        auto sp_session = make_pooled_shared<ssl_http_session>(boost::beast::tcp_stream(std::move(socket)), get_ssl_context(), std::move(buffer));
+        sp_session->set_admission_ticket(std::move(admission_ticket));
+        ssl_handshake_limiter_get_instance()->acquire([sp_session](std::shared_ptr<void> permit) {
+            boost::asio::post(sp_session->stream().get_executor(), [sp_session, permit]() {
+                if (!permit)
+                    return;
+                sp_session->set_handshake_permit(permit);
+                sp_session->run();
+            });
+        });
     } else {
-        std::make_shared<plain_http_session>(std::move(stream), std::move(buffer), handle_http_body_limit,
-                                       handle_http_timeout_seconds, handle_http_request)->run();
+        auto sp_session = make_pooled_shared<plain_http_session>(std::move(stream), std::move(buffer));
+        sp_session->set_admission_ticket(std::move(admission_ticket));
+        sp_session->run();
     }
 }
 
+// A connection shed by the admission control
+struct rejected_connection {
+    explicit rejected_connection(boost::asio::ip::tcp::socket&& socket) : stream(std::move(socket)) {}
+    boost::beast::tcp_stream            stream;
+    std::array<char, 512>               buffer;
+};
+
+// The request is drained until the client closes, a close with unread data would reset the response
+static void drain_rejected_connection(std::shared_ptr<rejected_connection> sp_connection) {
+    sp_connection->stream.async_read_some(boost::asio::buffer(sp_connection->buffer), [sp_connection](boost::beast::error_code ec, std::size_t) {
+        if (!ec)
+            drain_rejected_connection(sp_connection);
+    });
+}
+
+// The 503 is written, then the request is drained until the client closes
+static void respond_overloaded(std::shared_ptr<rejected_connection> sp_connection) {
+    static const char k_response[] = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\nRetry-After: 1\r\n\r\n";
+    boost::asio::async_write(sp_connection->stream, boost::asio::buffer(k_response, sizeof(k_response) - 1),
+                             [sp_connection](boost::beast::error_code ec, std::size_t) {
+        if (ec)
+            return;
+        sp_connection->stream.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+        drain_rejected_connection(sp_connection);
+    });
+}
+
+// The connections over the limits get a 503 at once, their request isn't parsed
+static void handle_overload(int mode, boost::asio::ip::tcp::socket&& socket) {
+    enum { drain_seconds = 2 };
+
+    server_counters_get_instance()->add(server_counters::connections_rejected);
+    // A TLS client can't read a plain response, it's closed
+    if (mode == ENDPOINT_MODE_TLS)
+        return;
+
+    auto sp_connection = std::make_shared<rejected_connection>(std::move(socket));
+    sp_connection->stream.expires_after(std::chrono::seconds(drain_seconds));
+    if (mode != ENDPOINT_MODE_FLEX)
+        return respond_overloaded(sp_connection);
+
+    // A flex endpoint tells the TLS clients by their first byte, as detect_session does: a ClientHello starts a handshake record
+    sp_connection->stream.async_read_some(boost::asio::buffer(sp_connection->buffer), [sp_connection](boost::beast::error_code ec, std::size_t) {
+        if (!ec && sp_connection->buffer[0] != 0x16)
+            respond_overloaded(sp_connection);
+    });
+}
+
 // this handle will be called when listener received the request of client's connection
-void handle_accept(boost::asio::ip::tcp::socket&& socket) {
-    boost::asio::post(socket.get_executor(), [socket = std::move(socket)]() mutable {
-        std::make_shared<detect_session>(std::move(socket), handle_ssl_detect)->run();
+void handle_accept(int mode, boost::asio::ip::tcp::socket&& socket) {
+    // A connection reset before it's accepted has no address, it's just closed
+    boost::beast::error_code ec;
+    const auto remote_endpoint = socket.remote_endpoint(ec);
+    if (ec)
+        return;
+    std::shared_ptr<void> admission_ticket;
+    if (!admission_controller_get_instance()->admit(remote_endpoint.address(), &admission_ticket))
+        return handle_overload(mode, std::move(socket));
+
+    set_connection_socket_options(socket);
+
+    // The connection is counted from now on, so that a burst of accepts is spread over the least loaded io_contexts
+    auto load_ticket = make_io_load_ticket(socket.get_executor());
+    boost::asio::post(socket.get_executor(), [mode, socket = std::move(socket), load_ticket, admission_ticket]() mutable {
+        // The dedicated endpoints skip the detection, the first bytes are read by the session
+        if (mode == ENDPOINT_MODE_FLEX)
+            make_pooled_shared<detect_session>(std::move(socket), handle_ssl_detect, std::move(admission_ticket))->run();
+        else
+            handle_ssl_detect(mode == ENDPOINT_MODE_TLS, boost::beast::tcp_stream(std::move(socket)), session_buffer_type(),
+                              std::move(admission_ticket));
     });
 }
 
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+// The local connections are plain, there is no TLS to detect. Only the global limit applies, they are closed over it.
+void handle_unix_accept(boost::asio::local::stream_protocol::socket&& socket) {
+    std::shared_ptr<void> admission_ticket;
+    if (!admission_controller_get_instance()->admit(&admission_ticket))
+        return server_counters_get_instance()->add(server_counters::connections_rejected);
+
+    auto load_ticket = make_io_load_ticket(socket.get_executor());
+    boost::asio::post(socket.get_executor(), [socket = std::move(socket), load_ticket, admission_ticket]() mutable {
+        auto sp_session = make_pooled_shared<unix_http_session>(unix_http_session::unix_stream_type(std::move(socket)), session_buffer_type());
+        sp_session->set_admission_ticket(std::move(admission_ticket));
+        sp_session->run();
+    });
+}
+
+// The socket file of a former run is removed before binding, but never a file of another type
+static void remove_unix_socket_file(const std::string& path) {
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) == 0 && S_ISSOCK(file_stat.st_mode))
+        unlink(path.c_str());
+}
+#endif
+
 // this handle will be called when listen thread is going to run
 void handle_listen(boost::asio::io_context& ioc, uint16_t listen_port) {
-    std::make_shared<listener>(ioc, listen_port, handle_accept)->run();
+    // With an io_context per thread, the acceptor i runs on the io_context i of the pool and the accepted sockets are
+    // distributed to the pool
+    auto pool = io_context_pool_get_instance();
+    auto acceptor_context = [&ioc, pool](uint32_t i) -> boost::asio::io_context& {
+        return pool ? pool->context(i % pool->size()) : ioc;
+    };
+    auto context_handle = [&ioc]() -> boost::asio::io_context& {
+        auto pool = io_context_pool_get_instance();
+        return pool ? pool->next() : ioc;
+    };
+    // With ADMISSION_PAUSE, the acceptors wait while the server is full
+    auto pause_handle = []() { return admission_controller_get_instance()->accept_paused(); };
+
+    // Several acceptors bound with SO_REUSEPORT accept in parallel, the kernel balances the new connections between them
+    auto acceptor_count = server_options_get_instance()->listen_acceptors;
+    if (acceptor_count > 1 && !listener::reuse_port_supported()) {
+        LOG(WARNING) << "handle_listen: SO_REUSEPORT is not supported, a single acceptor is used.";
+        acceptor_count = 1;
+    }
+    // An acceptor on each io_context of the pool: the connections stay on the one of their acceptor
+    const bool acceptor_per_context = pool && acceptor_count > 1 && acceptor_count >= pool->size();
+
+    // Without configured endpoints, the port of run_server detects TLS on all the interfaces
+    auto endpoints = server_options_get_instance()->endpoints;
+    const auto& unix_endpoints = server_options_get_instance()->unix_endpoints;
+    if (endpoints.empty() && unix_endpoints.empty())
+        endpoints.push_back(server_endpoint{ "0.0.0.0", listen_port, ENDPOINT_MODE_FLEX });
+    for (const auto& endpoint : endpoints) {
+        boost::beast::error_code ec;
+        const auto address = boost::asio::ip::make_address(endpoint.address, ec);
+        if (ec) {
+            handle_error(ec, "handle_listen.make_address");
+            continue;
+        }
+        if (endpoint.mode == ENDPOINT_MODE_TLS && !app_resource_get_instance()->ssl_enabled()) {
+            LOG(ERROR) << "handle_listen: the TLS endpoint " << endpoint.address << ":" << endpoint.port << " requires run_server with ssl.";
+            continue;
+        }
+
+        const int mode = endpoint.mode;
+        auto accept_handle = [mode](boost::asio::ip::tcp::socket&& socket) { handle_accept(mode, std::move(socket)); };
+        const boost::asio::ip::tcp::endpoint listen_endpoint{ address, endpoint.port };
+        for (uint32_t i = 0; i < acceptor_count; ++i) {
+            auto sp_listener = std::make_shared<listener>(acceptor_context(i), listen_endpoint, accept_handle, acceptor_count > 1,
+                                                          acceptor_per_context ? nullptr : listener::context_handle_type(context_handle));
+            sp_listener->set_pause_handle(pause_handle);
+            if (sp_listener->acceptor().is_open())
+                set_listener_socket_options(sp_listener->acceptor());
+            sp_listener->run();
+        }
+    }
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    for (const auto& endpoint : unix_endpoints) {
+        // The abstract names have no file: nothing to remove and no permissions
+        const bool abstract = endpoint.path[0] == '@';
+        std::string path = endpoint.path;
+        if (abstract)
+            path[0] = '\0';
+        else
+            remove_unix_socket_file(path);
+        auto sp_listener = std::make_shared<unix_listener>(acceptor_context(0), unix_listener::endpoint_type(path), handle_unix_accept, false,
+                                                           context_handle);
+        sp_listener->set_pause_handle(pause_handle);
+        sp_listener->run();
+        if (!abstract && endpoint.permissions && chmod(path.c_str(), static_cast<mode_t>(endpoint.permissions)) != 0) {
+            LOG(WARNING) << "handle_listen: the permissions of " << path << " can't be set.";
+        }
+    }
+#endif
+}
+
+// this handle will be called when the server is stopped
+void handle_unlisten(void) {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    for (const auto& endpoint : server_options_get_instance()->unix_endpoints) {
+        if (endpoint.path[0] != '@')
+            remove_unix_socket_file(endpoint.path);
+    }
+#endif
 }
@@ -6,8 +6,11 @@
 #ifndef SRC_SCAFFOLD_HANDLES_H_
 #define SRC_SCAFFOLD_HANDLES_H_
 
+#include <cstdint>
+#include <functional>
 #include <utility>
 #include <memory>
+#include <string>
 #include <boost/asio/io_context.hpp>
 #include "include/beast_utils.h"
 #include "base/memory_utils_base.hpp"
@@ -21,6 +24,8 @@ struct scaffold_handles {
     typedef std::pair<ws_open_handler_type, user_data_type>                 ws_open_handler_pair_type;
     typedef std::pair<ws_close_handler_type, user_data_type>                ws_close_handler_pair_type;
     typedef std::pair<ws_message_handler_type, user_data_type>              ws_message_handler_pair_type;
+    typedef std::pair<ws_data_message_handler_type, user_data_type>         ws_data_message_handler_pair_type;
+    typedef std::pair<ws_chunk_handler_type, user_data_type>                ws_chunk_handler_pair_type;
     typedef std::pair<server_shutdown_handler_type, user_data_type>         server_shutdown_handler_pair_type;
 
  public:
@@ -37,14 +42,53 @@ struct scaffold_handles {
     ws_open_handler_pair_type                   ws_open_handler_pair;
     ws_close_handler_pair_type                  ws_close_handler_pair;
     ws_message_handler_pair_type                ws_message_handler_pair;
+    ws_data_message_handler_pair_type           ws_data_message_handler_pair;
+    ws_chunk_handler_pair_type                  ws_chunk_handler_pair;
     server_shutdown_handler_pair_type           server_shutdown_handler_pair;
 };
 
 extern scaffold_handles* scaffold_handles_get_instance(void);
 void handle_listen(boost::asio::io_context& ioc, uint16_t listen_port);
-void ws_connection_send(std::shared_ptr<virtual_enable_shared_from_this_base> sp_connection, const char* message);
-void handle_ws_connection_open(std::shared_ptr<virtual_enable_shared_from_this_base> sp_ws_connection);
-void handle_ws_connection_close(virtual_enable_shared_from_this_base* ws_connection);
-void handle_ws_message(std::shared_ptr<virtual_enable_shared_from_this_base> sp_ws_connection, const char* message);
+void handle_unlisten(void);
+bool ws_send_message(uintptr_t connection_handle, const char* message);
+bool ws_send_message(uintptr_t connection_handle, std::shared_ptr<const std::string> sp_message, const std::string& key = std::string(),
+                     bool binary = false);
+int64_t ws_queued_bytes(uintptr_t connection_handle);
+int64_t ws_memory_bytes(uintptr_t connection_handle);
+uint32_t ws_broadcast_message(const std::string& topic, std::shared_ptr<const std::string> sp_message, uintptr_t exclude_handle,
+                              bool binary = false);
+void handle_ws_connection_open(uintptr_t connection_handle);
+void handle_ws_connection_close(uintptr_t connection_handle);
+void handle_ws_message(uintptr_t connection_handle, const char* message, std::size_t message_size, bool binary);
+void handle_ws_chunk(uintptr_t connection_handle, const char* chunk, std::size_t chunk_size, bool binary, bool is_final);
+uint32_t handle_http_body_limit(std::shared_ptr<virtual_enable_shared_from_this_base> sp_session);
+uint32_t handle_http_timeout_seconds(std::shared_ptr<virtual_enable_shared_from_this_base> sp_session);
+void handle_http_request(std::shared_ptr<virtual_enable_shared_from_this_base> sp_session, const char* head, const char* body, uint32_t body_size,
+                         std::function<void(uintptr_t, const char*, uint32_t)> response_cb);
+
+// The handler policies of the sessions of the server: the calls are bound at compile time
+struct scaffold_http_handlers {
+    typedef std::shared_ptr<virtual_enable_shared_from_this_base>           object_pointer_type;
+    typedef std::function<void(uintptr_t, const char*, uint32_t)>           response_handle_type;
+
+    uint32_t body_limit(object_pointer_type session) { return handle_http_body_limit(std::move(session)); }
+    uint32_t timeout_seconds(object_pointer_type session) { return handle_http_timeout_seconds(std::move(session)); }
+    void request(object_pointer_type session, const char* head, const char* body, uint32_t body_size, response_handle_type response_cb) {
+        handle_http_request(std::move(session), head, body, body_size, std::move(response_cb));
+    }
+};
+
+struct scaffold_ws_handlers {
+    // The messages are read in chunks if ws_read_chunk_size is set
+    bool chunked(void) const { return true; }
+    void open(uintptr_t connection_handle) { handle_ws_connection_open(connection_handle); }
+    void close(uintptr_t connection_handle) { handle_ws_connection_close(connection_handle); }
+    void message(uintptr_t connection_handle, const char* message, std::size_t message_size, bool binary) {
+        handle_ws_message(connection_handle, message, message_size, binary);
+    }
+    void chunk(uintptr_t connection_handle, const char* chunk, std::size_t chunk_size, bool binary, bool is_final) {
+        handle_ws_chunk(connection_handle, chunk, chunk_size, binary, is_final);
+    }
+};
 
 #endif  // SRC_SCAFFOLD_HANDLES_H_
@@ -0,0 +1,69 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/server_counters.h"
+#include <mutex>
+
+namespace {
+
+// The counts of a thread, only the thread writes them
+struct alignas(64) thread_counters {
+    thread_counters(void);
+    ~thread_counters(void);
+    std::array<std::atomic<uint64_t>, server_counters::counter_count>   values;
+    thread_counters*                                                    prev;
+    thread_counters*                                                    next;
+};
+
+// The threads are linked while they run, the counts of the exited ones are kept in g_retired
+std::mutex                                                          g_mutex;
+thread_counters*                                                    g_threads = nullptr;
+std::array<std::atomic<uint64_t>, server_counters::counter_count>   g_retired;
+
+// The counts made while the thread exits go to g_retired
+thread_local bool               t_counters_destroyed = false;
+thread_local thread_counters    t_counters;
+
+thread_counters::thread_counters(void) : prev(nullptr) {
+    for (auto& value : values)
+        value.store(0, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(g_mutex);
+    next = g_threads;
+    if (next)
+        next->prev = this;
+    g_threads = this;
+}
+
+thread_counters::~thread_counters(void) {
+    t_counters_destroyed = true;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (std::size_t id = 0; id < values.size(); ++id)
+        g_retired[id].fetch_add(values[id].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    if (prev)
+        prev->next = next;
+    else
+        g_threads = next;
+    if (next)
+        next->prev = prev;
+}
+
+}  // namespace
+
+void server_counters::add_thread_local(counter_id id, uint64_t value) {
+    if (t_counters_destroyed) {
+        g_retired[id].fetch_add(value, std::memory_order_relaxed);
+        return;
+    }
+    // A plain store: no other thread writes it, the readers only need a consistent value
+    auto& counter = t_counters.values[id];
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+uint64_t server_counters::thread_local_total(counter_id id) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    uint64_t total = g_retired[id].load(std::memory_order_relaxed);
+    for (auto counters = g_threads; counters; counters = counters->next)
+        total += counters->values[id].load(std::memory_order_relaxed);
+    return total;
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Process-wide statistics counters. A new counter is added to SERVER_COUNTER_LIST only:
+//
+//      server_counters_get_instance()->add(server_counters::ws_deflate_messages);
+//
+// A counter of a hot path (an allocation) is counted by each thread on its own cache line instead, the counts of the
+// threads are summed up when it's read:
+//
+//      server_counters::add_thread_local(server_counters::session_pool_hits);
+//
+
+#ifndef SRC_SERVER_COUNTERS_H_
+#define SRC_SERVER_COUNTERS_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#define SERVER_COUNTER_LIST(X)                                                                                  \
+    X(ws_deflate_messages)                  /* messages compressed by the connections which negotiated deflate */\
+    X(ws_deflate_raw_bytes)                 /* payload bytes of these messages */                               \
+    X(ws_deflate_sampled_messages)          /* messages compressed again to estimate the ratio and the cost */  \
+    X(ws_deflate_sampled_raw_bytes)                                                                             \
+    X(ws_deflate_sampled_compressed_bytes)                                                                      \
+    X(ws_deflate_sampled_cpu_nanoseconds)                                                                       \
+    X(ws_deflate_memory_per_connection)     /* estimated zlib memory (bytes) of a connection */                 \
+    X(ssl_handshakes_full)                                                                                      \
+    X(ssl_handshakes_resumed)               /* from the session cache or a session ticket */                    \
+    X(ssl_handshake_full_nanoseconds)       /* time spent in OpenSSL by the handshakes, the round trips excluded */ \
+    X(ssl_handshake_resumed_nanoseconds)                                                                        \
+    X(ssl_ticket_key_rotations)                                                                                 \
+    X(ssl_context_reloads)                                                                                      \
+    X(ssl_handshakes_queued)                /* handshakes which waited for the concurrency limit */             \
+    X(ssl_handshakes_waiting)                                                                                   \
+    X(ssl_handshake_wait_nanoseconds)                                                                           \
+    X(ssl_handshakes_refused)               /* closed over the cap of the waiting handshakes or after their wait */ \
+    X(connections_active)                   /* the connections holding an admission ticket */                  \
+    X(connections_rejected)                 /* shed over the connection limits */                               \
+    X(accept_backoffs)                      /* accept failures for lack of descriptors or memory */             \
+    X(accept_pauses)                        /* the acceptors waited for the connections to drop (ADMISSION_PAUSE) */ \
+    X(dispatch_requests)                    /* HTTP requests handed over to the event loop by the async bridge */ \
+    X(dispatch_sojourn_nanoseconds)         /* the time they waited in the queue */                             \
+    X(dispatch_shed)                        /* answered with a 503 by the CoDel control */                      \
+    X(dispatch_overloads)                   /* the times the request queue got overloaded */                    \
+    X(dispatch_timeouts)                    /* not answered by the event loop within the request timeout */     \
+    X(rate_limited_requests)                /* answered with a 429 */                                           \
+    X(rate_limited_ws_messages)             /* dropped before the message handler */                           \
+    X(rate_limit_buckets)                   /* the token buckets of the active clients */                       \
+    X(rate_limit_buckets_full)              /* new clients refused while the buckets were at their cap */       \
+    X(http_read_timeouts)                   /* connections dropped while idle or sending a request too slowly */ \
+    X(http_write_timeouts)                  /* connections dropped while reading a response too slowly */       \
+    X(http_idle_connections)                /* keep-alive connections waiting for their next request */         \
+    X(http_idle_reaped)                     /* idle connections expired by the timer wheels */                  \
+    X(http_idle_evictions)                  /* the oldest idle connections closed over the cap */               \
+    X(session_buffer_bytes)                 /* the read buffers held by the HTTP and WebSocket sessions */      \
+    X(session_pool_hits)                    /* session blocks reused from the free lists of the threads */      \
+    X(session_pool_misses)                  /* session blocks allocated from the heap */                        \
+    X(http_requests)                        /* requests read by the HTTP sessions */                            \
+    X(handler_arena_hits)                   /* async operations held by the slots of their session */           \
+    X(handler_arena_misses)                 /* async operations allocated by the session pool */
+
+class server_counters {
+ public:
+    typedef server_counters                                                 this_type;
+    typedef std::function<void(const char* name, uint64_t value)>          visit_handle_type;
+#define SERVER_COUNTER_ENUM(name) name,
+    enum counter_id { SERVER_COUNTER_LIST(SERVER_COUNTER_ENUM) counter_count };
+#undef SERVER_COUNTER_ENUM
+
+ public:
+    server_counters(void) { for (auto& value : values_) value.store(0, std::memory_order_relaxed); }
+    explicit server_counters(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+ public:
+    void add(counter_id id, uint64_t value = 1) { values_[id].fetch_add(value, std::memory_order_relaxed); }
+    void sub(counter_id id, uint64_t value = 1) { values_[id].fetch_sub(value, std::memory_order_relaxed); }
+    void set(counter_id id, uint64_t value) { values_[id].store(value, std::memory_order_relaxed); }
+    uint64_t get(counter_id id) const { return values_[id].load(std::memory_order_relaxed) + thread_local_total(id); }
+    // The counts of the threads outlive the instance, they are kept for the process
+    static void add_thread_local(counter_id id, uint64_t value = 1);
+    void visit(visit_handle_type visit_handle) const {
+#define SERVER_COUNTER_NAME(name) #name,
+        static const char* const k_names[counter_count] = { SERVER_COUNTER_LIST(SERVER_COUNTER_NAME) };
+#undef SERVER_COUNTER_NAME
+        for (int id = 0; id < counter_count; ++id)
+            visit_handle(k_names[id], get(static_cast<counter_id>(id)));
+    }
+
+ private:
+    static uint64_t thread_local_total(counter_id id);
+
+ private:
+    std::array<std::atomic<uint64_t>, counter_count>        values_;
+};
+
+server_counters* server_counters_get_instance(void);
+
+#endif  // SRC_SERVER_COUNTERS_H_
@@ -0,0 +1,170 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SRC_SERVER_OPTIONS_H_
+#define SRC_SERVER_OPTIONS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "include/beast_utils.h"
+
+// A listening endpoint, mode: ENDPOINT_MODE_XXX
+struct server_endpoint {
+    std::string                                 address;
+    uint16_t                                    port;
+    int                                         mode;
+};
+
+// A local (AF_UNIX) endpoint, a path beginning with '@' is in the abstract namespace (Linux). The permissions
+// (e.g. 0660) are set on the socket file, 0 keeps the ones of the umask.
+struct server_unix_endpoint {
+    std::string                                 path;
+    uint32_t                                    permissions;
+};
+
+// A rate limit of the routes beginning with prefix: rate tokens per second per client, up to burst at once
+struct server_rate_rule {
+    std::string                                 prefix;
+    double                                      rate;
+    uint32_t                                    burst;
+};
+
+// The tunables of the server. They are set before run_server and read by the sessions when they are created.
+struct server_options {
+ public:
+    server_options(void) : listen_acceptors(1), tcp_nodelay(false), socket_send_buffer(0), socket_receive_buffer(0), socket_busy_poll(0),
+                           tcp_defer_accept(0), tcp_fastopen_queue(0), tcp_keepalive_idle(0), tcp_keepalive_interval(0),
+                           tcp_keepalive_count(0), io_context_per_thread(false), io_distribution(IO_DISTRIBUTION_ROUND_ROBIN), ws_write_queue_limit(0), ws_write_queue_policy(WS_QUEUE_DROP_OLDEST), ws_deflate_enable(false),
+                           ws_deflate_window_bits(15), ws_deflate_mem_level(4), ws_deflate_comp_level(6), ws_deflate_no_context_takeover(false),
+                           ws_deflate_min_size(0), ws_read_message_max(16 * 1024 * 1024), ws_read_chunk_size(0),
+                           ssl_session_cache_size(20 * 1024), ssl_session_timeout(2 * 60 * 60), ssl_session_tickets(true),
+                           ssl_ticket_key_rotation(60 * 60), ssl_profile(SSL_PROFILE_LEGACY), ssl_prefer_server_ciphers(true), ssl_dh(true),
+                           ssl_handshake_threads(0), ssl_handshake_concurrency(0), ssl_handshake_max_waiting(1024),
+                           ssl_handshake_wait_timeout(10 * 1000), max_connections(0), max_connections_per_ip(0),
+                           overload_policy(ADMISSION_REJECT), rate_limit_max_buckets(100 * 1000), http_idle_timeout(0), http_header_timeout(0), http_body_timeout(0),
+                           http_write_timeout(0), http_min_read_rate(0), http_min_write_rate(0),
+                           http_max_idle_connections(0), low_memory(false), connection_buffer_max(0),
+                           session_pool_cache_bytes(256 * 1024), handler_arena(true) {}
+
+ public:
+    // The acceptors of the listening port, more than one are bound with SO_REUSEPORT and accept in parallel
+    uint32_t                                    listen_acceptors;
+    // The listening endpoints, the port of run_server is used (flex, all the interfaces) if there is none
+    std::vector<server_endpoint>                endpoints;
+    std::vector<server_unix_endpoint>           unix_endpoints;
+
+    // The socket option profile of the TCP connections, 0 keeps the default of the system: the buffers (bytes),
+    // the busy polling (microseconds), the data awaited before the accept (seconds), the queue of the TCP Fast Open
+    // requests and the keepalive probes (the idle time and the interval in seconds, the probes before the close)
+    bool                                        tcp_nodelay;
+    uint32_t                                    socket_send_buffer;
+    uint32_t                                    socket_receive_buffer;
+    uint32_t                                    socket_busy_poll;
+    uint32_t                                    tcp_defer_accept;
+    uint32_t                                    tcp_fastopen_queue;
+    uint32_t                                    tcp_keepalive_idle;
+    uint32_t                                    tcp_keepalive_interval;
+    uint32_t                                    tcp_keepalive_count;
+
+    // Run an io_context per thread instead of sharing one, the connections are distributed by io_distribution
+    // (IO_DISTRIBUTION_XXX) and the thread i is pinned to io_cpu_affinity[i % size] (no pinning if empty)
+    bool                                        io_context_per_thread;
+    int                                         io_distribution;
+    std::vector<int>                            io_cpu_affinity;
+
+    // The high-water mark (bytes) of the outbound queue of a WebSocket connection, 0 means unlimited
+    std::size_t                                 ws_write_queue_limit;
+    int                                         ws_write_queue_policy;
+
+    // permessage-deflate: the window bits (9~15) and the memory level (1~9) set the memory held by every connection,
+    // without context takeover it is released after each message at the cost of a worse ratio
+    bool                                        ws_deflate_enable;
+    int                                         ws_deflate_window_bits;
+    int                                         ws_deflate_mem_level;
+    int                                         ws_deflate_comp_level;
+    bool                                        ws_deflate_no_context_takeover;
+    std::size_t                                 ws_deflate_min_size;
+
+    // The max size (bytes) of an inbound message, 0 means unlimited. A larger message closes the connection (1009).
+    uint64_t                                    ws_read_message_max;
+    // The max size of a fragment handed to the chunk handler, 0 means that the messages are received whole
+    std::size_t                                 ws_read_chunk_size;
+
+    // TLS session resumption: the sessions cached by the server (0 disables the cache) and their lifetime (seconds),
+    // the session tickets and the rotation interval (seconds) of their keys
+    uint32_t                                    ssl_session_cache_size;
+    uint32_t                                    ssl_session_timeout;
+    bool                                        ssl_session_tickets;
+    uint32_t                                    ssl_ticket_key_rotation;
+
+    // The security profile (SSL_PROFILE_XXX), the empty lists mean the defaults of the profile
+    int                                         ssl_profile;
+    std::string                                 ssl_curves;
+    std::string                                 ssl_ciphers;
+    std::string                                 ssl_ciphersuites;
+    bool                                        ssl_prefer_server_ciphers;
+    // Load the finite-field DH parameters (DHE key exchange), ECDHE doesn't need them
+    bool                                        ssl_dh;
+
+    // The threads of the TLS pool (0: the TLS connections run on the io threads) and the max handshakes at once
+    // (0: unlimited), the others wait for their turn
+    uint32_t                                    ssl_handshake_threads;
+    uint32_t                                    ssl_handshake_concurrency;
+    // Past the limit, the max waiting handshakes and their max wait in milliseconds (0: unlimited), the others are closed
+    uint32_t                                    ssl_handshake_max_waiting;
+    uint32_t                                    ssl_handshake_wait_timeout;
+
+    // The max opened connections (0: unlimited), globally and per client address, and what happens over the
+    // global limit (ADMISSION_XXX): a 503 to the new connections, or the acceptors wait for the connections to drop
+    uint32_t                                    max_connections;
+    uint32_t                                    max_connections_per_ip;
+    int                                         overload_policy;
+
+    // The rate limits of the requests and the WebSocket messages, the clients are told apart by their address and
+    // the value of rate_limit_key_header (e.g. an API key) if it's set. The buckets are capped (0: unlimited).
+    std::vector<server_rate_rule>               rate_limit_rules;
+    std::string                                 rate_limit_key_header;
+    uint32_t                                    rate_limit_max_buckets;
+
+    // The HTTP timeouts (seconds, 0: the one of the timeout handler for the whole request): waiting for the next request
+    // of a keep-alive connection, receiving the header (also the TLS detection and handshake) and the body, sending a
+    // response. The deadline of the header, the body and the response is extended by 1 s per min rate bytes (per second).
+    uint32_t                                    http_idle_timeout;
+    uint32_t                                    http_header_timeout;
+    uint32_t                                    http_body_timeout;
+    uint32_t                                    http_write_timeout;
+    uint32_t                                    http_min_read_rate;
+    uint32_t                                    http_min_write_rate;
+    // The cap of the keep-alive connections waiting for their next request (0: unlimited), the oldest one is closed
+    // to make room. The idle connections are expired by a timer wheel per io_context.
+    uint32_t                                    http_max_idle_connections;
+
+    // The low-memory mode for many idle connections: the read buffers are released after each message, an idle plain
+    // HTTP connection waits without one and OpenSSL releases its buffers (SSL_MODE_RELEASE_BUFFERS). The read buffer of
+    // a connection (the header and the pipelined requests, a WebSocket message) is capped at connection_buffer_max
+    // bytes (0: unlimited).
+    bool                                        low_memory;
+    std::size_t                                 connection_buffer_max;
+
+    // The sessions, their buffers and their request headers are recycled by free lists per thread and per size class,
+    // each keeps up to this many bytes (0: the blocks go back to the heap)
+    std::size_t                                 session_pool_cache_bytes;
+
+    // The async operations of a session are allocated by a few slots of the session rather than by the session pool.
+    // The slots take a 4 KB block per session: they are off in the low-memory mode.
+    bool                                        handler_arena;
+
+ public:
+    // A request is read in phases, each with its own deadline, the idle phase is watched by the timer wheels
+    bool http_read_phases(void) const {
+        return http_idle_timeout || http_header_timeout || http_body_timeout || http_min_read_rate || http_max_idle_connections ||
+               low_memory;
+    }
+};
+
+server_options* server_options_get_instance(void);
+
+#endif  // SRC_SERVER_OPTIONS_H_
@@ -0,0 +1,129 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/session_benchmark.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <boost/asio/io_context.hpp>
+#include "base/memory_utils.hpp"
+#include "include/beast_utils.h"
+#include "net/http_session_plain.h"
+#include "net/websocket_session_plain.h"
+#include "src/ws_connection_registry.h"
+
+namespace {
+
+typedef std::chrono::steady_clock                                       clock_type;
+typedef std::shared_ptr<virtual_enable_shared_from_this_base>           object_pointer_type;
+typedef std::function<void(uintptr_t, const char*, uint32_t)>           response_handle_type;
+
+// Keeps the results alive, so that the loops aren't optimized out
+volatile uintptr_t g_sink = 0;
+
+uint32_t idle_body_limit(object_pointer_type) { return 1024; }
+uint32_t idle_timeout_seconds(object_pointer_type) { return 30; }
+void idle_request(object_pointer_type session, const char*, const char*, uint32_t, response_handle_type response_cb) {
+    response_cb(object_handle_from_pointer(session), nullptr, 0);
+}
+void idle_response(std::shared_ptr<plain_http_session> session, uintptr_t server_data, const char*, uint32_t) {
+    g_sink = g_sink + server_data + (session ? 1 : 0);
+}
+
+struct idle_http_handlers {
+    uint32_t body_limit(object_pointer_type session) { return idle_body_limit(std::move(session)); }
+    uint32_t timeout_seconds(object_pointer_type session) { return idle_timeout_seconds(std::move(session)); }
+    void request(object_pointer_type session, const char* head, const char* body, uint32_t body_size, response_handle_type response_cb) {
+        idle_request(std::move(session), head, body, body_size, std::move(response_cb));
+    }
+};
+
+// The calls of http_session for a request: the limit, the timeout and the request with its response handle
+template<class Handlers, class ResponseFactory>
+void dispatch_request(Handlers& handlers, virtual_enable_shared_from_this_base* session, ResponseFactory make_response) {
+    g_sink = g_sink + handlers.body_limit(session->shared_from_this());
+    g_sink = g_sink + handlers.timeout_seconds(session->shared_from_this());
+    handlers.request(session->shared_from_this(), "", "", 0, make_response());
+}
+
+template<class Operation>
+double measure(uint32_t iterations, Operation operation) {
+    const auto start = clock_type::now();
+    for (uint32_t i = 0; i < iterations; ++i)
+        operation();
+    const auto elapsed = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+    return iterations ? elapsed / iterations : 0;
+}
+
+}  // namespace
+
+double benchmark_session_dispatch(int operation, bool type_erased, uint32_t iterations) {
+    // The sessions are never run: their streams aren't connected
+    boost::asio::io_context ioc;
+    auto http_session = std::make_shared<plain_http_session>(boost::beast::tcp_stream(ioc), session_buffer_type());
+    virtual_enable_shared_from_this_base* http_base = http_session.get();
+
+    switch (operation) {
+    case SESSION_DISPATCH_SHARED_FROM_THIS:
+        if (type_erased)
+            return measure(iterations, [http_base]() {
+                g_sink = g_sink + handle_from_pointer(std::dynamic_pointer_cast<plain_http_session>(http_base->shared_from_this()));
+            });
+        return measure(iterations, [&http_session]() {
+            g_sink = g_sink + handle_from_pointer(http_session->virtual_enable_shared_from_this<plain_http_session>::shared_from_this());
+        });
+
+    case SESSION_DISPATCH_HTTP_HANDLERS:
+        if (type_erased) {
+            function_http_handlers handlers{ idle_body_limit, idle_timeout_seconds, idle_request };
+            return measure(iterations, [&handlers, http_base]() {
+                dispatch_request(handlers, http_base, [http_base]() -> response_handle_type {
+                    return std::bind(idle_response, std::dynamic_pointer_cast<plain_http_session>(http_base->shared_from_this()),
+                                     std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+                });
+            });
+        } else {
+            idle_http_handlers handlers;
+            plain_http_session* session = http_session.get();
+            return measure(iterations, [&handlers, http_base, session]() {
+                // The handle holds the session like http_session::response_handle
+                dispatch_request(handlers, http_base, [session]() -> response_handle_type {
+                    return [self = session->virtual_enable_shared_from_this<plain_http_session>::shared_from_this()](uintptr_t server_data, const char*, uint32_t) {
+                        g_sink = g_sink + server_data + handle_from_pointer(self);
+                    };
+                });
+            });
+        }
+
+    case SESSION_DISPATCH_WS_LOOKUP: {
+        // The lookup of ws_connection_send, the session is registered for the run
+        auto ws_session = std::make_shared<plain_websocket_session>(boost::beast::tcp_stream(ioc));
+        auto registry = ws_connection_registry_get_instance();
+        const auto handle = registry->add(ws_session);
+        if (!handle)
+            return 0;
+        double result = 0;
+        if (type_erased) {
+            result = measure(iterations, [registry, handle]() {
+                auto connection = registry->find(handle);
+                auto* session = dynamic_cast<plain_websocket_session*>(connection.get());
+                if (session)
+                    g_sink = g_sink + session->queued_bytes();
+            });
+        } else {
+            result = measure(iterations, [registry, handle]() {
+                auto session = registry->find_session(handle);
+                if (session)
+                    g_sink = g_sink + session.queued_bytes();
+            });
+        }
+        registry->remove(handle);
+        return result;
+    }
+
+    default:
+        return 0;
+    }
+}
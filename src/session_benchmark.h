@@ -0,0 +1,15 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SRC_SESSION_BENCHMARK_H_
+#define SRC_SESSION_BENCHMARK_H_
+
+#include <cstdint>
+
+// Run an operation of the session plumbing (SESSION_DISPATCH_XXX) on idle sessions, through the type-erased path of
+// the former sessions (std::function, std::bind, dynamic_cast) or through the static one. The handlers do nothing, only
+// the dispatch is measured. Returns the nanoseconds per operation, or 0 if the operation is unknown.
+double benchmark_session_dispatch(int operation, bool type_erased, uint32_t iterations);
+
+#endif  // SRC_SESSION_BENCHMARK_H_
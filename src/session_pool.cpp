@@ -0,0 +1,96 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/session_pool.h"
+#include <array>
+#include <new>
+#include "src/server_counters.h"
+
+namespace {
+
+struct free_block {
+    free_block*         next;
+};
+
+struct free_list {
+    free_block*         head;
+    std::size_t         count;
+};
+
+struct thread_cache {
+    thread_cache(void) { for (auto& list : lists) list = free_list{ nullptr, 0 }; }
+    ~thread_cache(void);
+    std::array<free_list, session_pool::class_count>    lists;
+};
+
+// The blocks freed while the thread exits go back to the heap
+thread_local bool           t_cache_destroyed = false;
+thread_local thread_cache   t_cache;
+
+thread_cache::~thread_cache(void) {
+    t_cache_destroyed = true;
+    for (auto& list : lists) {
+        while (list.head) {
+            auto block = list.head;
+            list.head = block->next;
+            ::operator delete(block);
+        }
+    }
+}
+
+// -1 if the block is too large to be pooled
+int size_class(std::size_t size) {
+    int bits = session_pool::min_block_bits;
+    while ((std::size_t(1) << bits) < size) {
+        if (++bits > session_pool::max_block_bits)
+            return -1;
+    }
+    return bits - session_pool::min_block_bits;
+}
+
+}  // namespace
+
+std::atomic<std::size_t> session_pool::cache_limit_(256 * 1024);
+
+void session_pool::set_cache_limit(std::size_t cache_bytes_per_class) {
+    cache_limit_.store(cache_bytes_per_class, std::memory_order_relaxed);
+}
+
+void* session_pool::allocate(std::size_t size) {
+    const int index = size_class(size);
+    if (index >= 0 && !t_cache_destroyed) {
+        auto& list = t_cache.lists[index];
+        if (list.head) {
+            auto block = list.head;
+            list.head = block->next;
+            --list.count;
+            server_counters::add_thread_local(server_counters::session_pool_hits);
+            return block;
+        }
+    }
+    server_counters::add_thread_local(server_counters::session_pool_misses);
+    return ::operator new(block_size(size));
+}
+
+std::size_t session_pool::block_size(std::size_t size) {
+    const int index = size_class(size);
+    return index >= 0 ? std::size_t(1) << (index + min_block_bits) : size;
+}
+
+void session_pool::deallocate(void* block, std::size_t size) noexcept {
+    if (!block)
+        return;
+    const int index = size_class(size);
+    if (index >= 0 && !t_cache_destroyed) {
+        auto& list = t_cache.lists[index];
+        if (((list.count + 1) << (index + min_block_bits)) <= cache_limit_.load(std::memory_order_relaxed)) {
+            auto free = static_cast<free_block*>(block);
+            free->next = list.head;
+            list.head = free;
+            ++list.count;
+            return;
+        }
+    }
+    ::operator delete(block);
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Recycles the memory of the sessions, their buffers and their request headers. A thread keeps a free list per size
+// class (powers of two from 64 bytes to 64 KB), a block freed on a thread goes to its list, up to the cache limit of
+// the class, the others go back to the heap:
+//
+//      allocate(1500)          --> a 2048 bytes block of the free list (a hit), or of the heap (a miss)
+//      deallocate(p, 1500)     --> pushed to the free list of the 2048 bytes class
+//
+// The larger blocks aren't pooled.
+//
+
+#ifndef SRC_SESSION_POOL_H_
+#define SRC_SESSION_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <boost/beast/core/flat_buffer.hpp>
+
+class session_pool {
+ public:
+    enum { min_block_bits = 6, max_block_bits = 16, class_count = max_block_bits - min_block_bits + 1 };
+
+ public:
+    // The bytes kept by a free list of a thread (0: the blocks always go back to the heap)
+    static void set_cache_limit(std::size_t cache_bytes_per_class);
+    static void* allocate(std::size_t size);
+    static void deallocate(void* block, std::size_t size) noexcept;
+    // The bytes held by a block of this size, the one of its size class
+    static std::size_t block_size(std::size_t size);
+
+ private:
+    static std::atomic<std::size_t>     cache_limit_;
+};
+
+template<class T>
+class session_allocator {
+ public:
+    typedef T                                                               value_type;
+    typedef std::true_type                                                  propagate_on_container_move_assignment;
+    typedef std::true_type                                                  is_always_equal;
+
+ public:
+    session_allocator(void) noexcept {}
+    template<class U> session_allocator(const session_allocator<U>&) noexcept {}
+
+ public:
+    T* allocate(std::size_t n) { return static_cast<T*>(session_pool::allocate(n * sizeof(T))); }
+    void deallocate(T* p, std::size_t n) noexcept { session_pool::deallocate(p, n * sizeof(T)); }
+    template<class U> bool operator==(const session_allocator<U>&) const noexcept { return true; }
+    template<class U> bool operator!=(const session_allocator<U>&) const noexcept { return false; }
+};
+
+// The read buffer of a session
+typedef boost::beast::basic_flat_buffer<session_allocator<char>>            session_buffer_type;
+
+// The session and its control block are a single pooled block
+template<class T, class... Args>
+std::shared_ptr<T> make_pooled_shared(Args&&... args) {
+    return std::allocate_shared<T>(session_allocator<T>(), std::forward<Args>(args)...);
+}
+
+#endif  // SRC_SESSION_POOL_H_
@@ -0,0 +1,75 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/ssl_benchmark.h"
+#include <chrono>
+#include <boost/asio/ssl/context.hpp>
+#include "base/utils.h"
+#include "src/ssl_certificate.h"
+
+namespace {
+
+typedef std::chrono::steady_clock       clock_type;
+
+// Returns false if the handshake failed
+bool run_handshake(SSL_CTX* server_context, SSL_CTX* client_context, clock_type::duration* server_time) {
+    BIO* client_bio = nullptr;
+    BIO* server_bio = nullptr;
+    if (!BIO_new_bio_pair(&client_bio, 0, &server_bio, 0))
+        return false;
+    SSL* client = SSL_new(client_context);
+    SSL* server = SSL_new(server_context);
+    if (!client || !server) {
+        SSL_free(client);
+        SSL_free(server);
+        BIO_free(client_bio);
+        BIO_free(server_bio);
+        return false;
+    }
+    SSL_set_bio(client, client_bio, client_bio);
+    SSL_set_bio(server, server_bio, server_bio);
+    SSL_set_connect_state(client);
+    SSL_set_accept_state(server);
+
+    bool success = true;
+    for (int round = 0; success && !(SSL_is_init_finished(client) && SSL_is_init_finished(server)); ++round) {
+        const int client_result = SSL_do_handshake(client);
+        const auto start = clock_type::now();
+        const int server_result = SSL_do_handshake(server);
+        *server_time += clock_type::now() - start;
+        const auto want = [](SSL* ssl, int result) {
+            const int error = SSL_get_error(ssl, result);
+            return result == 1 || error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE;
+        };
+        success = round < 16 && want(client, client_result) && want(server, server_result);
+    }
+
+    SSL_free(client);
+    SSL_free(server);
+    return success;
+}
+
+}  // namespace
+
+double benchmark_ssl_handshakes(const server_options& options, uint32_t handshake_count) {
+    boost::asio::ssl::context server_context{ boost::asio::ssl::context::tls_server };
+    if (!load_server_certificate(&server_context, options) || !configure_ssl_profile(&server_context, options))
+        return 0;
+    SSL_CTX_set_session_cache_mode(server_context.native_handle(), SSL_SESS_CACHE_OFF);
+    SSL_CTX_set_options(server_context.native_handle(), SSL_OP_NO_TICKET);
+
+    boost::asio::ssl::context client_context{ boost::asio::ssl::context::tls_client };
+    client_context.set_verify_mode(boost::asio::ssl::verify_none);
+    SSL_CTX_set_session_cache_mode(client_context.native_handle(), SSL_SESS_CACHE_OFF);
+
+    clock_type::duration server_time(0);
+    for (uint32_t i = 0; i < handshake_count; ++i) {
+        if (!run_handshake(server_context.native_handle(), client_context.native_handle(), &server_time)) {
+            LOG(ERROR) << "benchmark_ssl_handshakes: the handshake of the profile " << options.ssl_profile << " failed.";
+            return 0;
+        }
+    }
+    const double seconds = std::chrono::duration<double>(server_time).count();
+    return seconds > 0 ? handshake_count / seconds : 0;
+}
@@ -0,0 +1,15 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SRC_SSL_BENCHMARK_H_
+#define SRC_SSL_BENCHMARK_H_
+
+#include <cstdint>
+#include "src/server_options.h"
+
+// Run full handshakes between a client and a server connected by memory BIOs, only the time spent by the server
+// side is counted. Returns the handshakes per second, or 0 if the profile can't be set up.
+double benchmark_ssl_handshakes(const server_options& options, uint32_t handshake_count);
+
+#endif  // SRC_SSL_BENCHMARK_H_
@@ -4,8 +4,10 @@
 
 #include "src/ssl_certificate.h"
 #include <string>
+#include "base/utils.h"
 #include "net/net_utils.h"
 #include "src/scaffold_handles.h"
+#include "src/ssl_session_cache.h"
 
 template<typename FunctorCBType>
 const std::string invoke_python_string_cb(FunctorCBType functor_cb, std::size_t init_size = 1024) {
@@ -18,7 +20,7 @@ const std::string invoke_python_string_cb(FunctorCBType functor_cb, std::size_t
     return "";
 }
 
-void load_server_certificate(boost::asio::ssl::context* ctx) {
+bool load_server_certificate(boost::asio::ssl::context* ctx, const server_options& options) {
     std::string const default_certificate =
         "-----BEGIN CERTIFICATE-----\n"
         "MIIDaDCCAlCgAwIBAgIJAO8vBu8i8exWMA0GCSqGSIb3DQEBCwUAMEkxCzAJBgNV\n"
@@ -87,7 +89,8 @@ void load_server_certificate(boost::asio::ssl::context* ctx) {
     auto ssl_cert = handles->ssl_certificate_handler;
     const std::string certificate = ssl_cert ? invoke_python_string_cb(ssl_cert, default_certificate.size() * 2) : default_certificate;
     const std::string key = handles->ssl_key_handler ? invoke_python_string_cb(handles->ssl_key_handler, default_key.size() * 2) : default_key;
-    const std::string dh = handles->ssl_db_handller ? invoke_python_string_cb(handles->ssl_db_handller, default_dh.size() * 2) : default_dh;
+    const std::string dh = !options.ssl_dh ? std::string() : handles->ssl_db_handller ? invoke_python_string_cb(handles->ssl_db_handller,
+                           default_dh.size() * 2) : default_dh;
 
     if (handles->ssl_password_handler) {
         auto password_cb = handles->ssl_password_handler;
@@ -99,15 +102,82 @@ void load_server_certificate(boost::asio::ssl::context* ctx) {
         ctx->set_password_callback(default_password_cb);
     }
 
-    ctx->set_options(boost::asio::ssl::context::default_workarounds | boost::asio::ssl::context::no_sslv2 | boost::asio::ssl::context::single_dh_use);
+    ctx->set_options(boost::asio::ssl::context::default_workarounds | boost::asio::ssl::context::no_sslv2 |
+                     (options.ssl_dh ? boost::asio::ssl::context::single_dh_use : 0));
     boost::beast::error_code ec;
     ctx->use_certificate_chain(boost::asio::buffer(certificate.data(), certificate.size()), ec);
-    if (ec)
-        return handle_error(ec, "load_server_certificate.use_certificate_chain");
+    if (ec) {
+        handle_error(ec, "load_server_certificate.use_certificate_chain");
+        return false;
+    }
     ctx->use_private_key(boost::asio::buffer(key.data(), key.size()), boost::asio::ssl::context::file_format::pem, ec);
-    if (ec)
-        return handle_error(ec, "load_server_certificate.use_private_key");
+    if (ec) {
+        handle_error(ec, "load_server_certificate.use_private_key");
+        return false;
+    }
+    if (!options.ssl_dh)
+        return true;
     ctx->use_tmp_dh(boost::asio::buffer(dh.data(), dh.size()), ec);
-    if (ec)
-        return handle_error(ec, "load_server_certificate.use_private_key");
+    if (ec) {
+        handle_error(ec, "load_server_certificate.use_tmp_dh");
+        return false;
+    }
+    return true;
+}
+
+bool configure_ssl_profile(boost::asio::ssl::context* ctx, const server_options& options) {
+    // ECDHE with AEAD ciphers only, the DHE ones are appended when the DH parameters are loaded
+    static const char k_intermediate_ciphers[] = "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:ECDHE-ECDSA-AES256-GCM-SHA384:"
+        "ECDHE-RSA-AES256-GCM-SHA384:ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305";
+    static const char k_dhe_ciphers[] = ":DHE-RSA-AES128-GCM-SHA256:DHE-RSA-AES256-GCM-SHA384:DHE-RSA-CHACHA20-POLY1305";
+    static const char k_default_curves[] = "X25519:P-256:P-384";
+
+    SSL_CTX* native_context = ctx->native_handle();
+    int min_version = TLS1_2_VERSION, max_version = TLS1_2_VERSION;
+    std::string ciphers = options.ssl_ciphers, curves = options.ssl_curves;
+    switch (options.ssl_profile) {
+    case SSL_PROFILE_INTERMEDIATE:
+        max_version = TLS1_3_VERSION;
+        if (ciphers.empty())
+            ciphers = std::string(k_intermediate_ciphers) + (options.ssl_dh ? k_dhe_ciphers : "");
+        break;
+    case SSL_PROFILE_MODERN:
+        min_version = max_version = TLS1_3_VERSION;
+        break;
+    default:
+        break;
+    }
+    if (curves.empty() && options.ssl_profile != SSL_PROFILE_LEGACY)
+        curves = k_default_curves;
+
+    if (!SSL_CTX_set_min_proto_version(native_context, min_version) || !SSL_CTX_set_max_proto_version(native_context, max_version)) {
+        LOG(ERROR) << "configure_ssl_profile: the protocol versions of the profile " << options.ssl_profile << " are not supported.";
+        return false;
+    }
+    if (!curves.empty() && !SSL_CTX_set1_groups_list(native_context, curves.c_str())) {
+        LOG(ERROR) << "configure_ssl_profile: invalid curves(" << curves << ").";
+        return false;
+    }
+    if (!ciphers.empty() && !SSL_CTX_set_cipher_list(native_context, ciphers.c_str())) {
+        LOG(ERROR) << "configure_ssl_profile: invalid ciphers(" << ciphers << ").";
+        return false;
+    }
+    if (!options.ssl_ciphersuites.empty() && !SSL_CTX_set_ciphersuites(native_context, options.ssl_ciphersuites.c_str())) {
+        LOG(ERROR) << "configure_ssl_profile: invalid ciphersuites(" << options.ssl_ciphersuites << ").";
+        return false;
+    }
+    if (options.ssl_prefer_server_ciphers)
+        SSL_CTX_set_options(native_context, SSL_OP_CIPHER_SERVER_PREFERENCE);
+    // The record buffers are freed while a connection is idle
+    if (options.low_memory)
+        SSL_CTX_set_mode(native_context, SSL_MODE_RELEASE_BUFFERS);
+    return true;
+}
+
+std::shared_ptr<boost::asio::ssl::context> make_server_ssl_context(const server_options& options, bool* success) {
+    auto ctx = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tls_server);
+    *success = load_server_certificate(ctx.get(), options);
+    *success = configure_ssl_profile(ctx.get(), options) && *success;
+    configure_ssl_session_resumption(ctx.get());
+    return ctx;
 }
@@ -5,8 +5,15 @@
 #ifndef SRC_SSL_CERTIFICATE_H_
 #define SRC_SSL_CERTIFICATE_H_
 
+#include <memory>
 #include <boost/asio/ssl/context.hpp>
+#include "src/server_options.h"
 
-void load_server_certificate(boost::asio::ssl::context* ctx);
+bool load_server_certificate(boost::asio::ssl::context* ctx, const server_options& options);
+// Set the protocol versions, the curves and the ciphers of the security profile
+bool configure_ssl_profile(boost::asio::ssl::context* ctx, const server_options& options);
+// Build a server context through the certificate handlers, with the security profile and the session resumption.
+// The context is returned even if it is incomplete, success tells whether it can be used.
+std::shared_ptr<boost::asio::ssl::context> make_server_ssl_context(const server_options& options, bool* success);
 
 #endif  // SRC_SSL_CERTIFICATE_H_
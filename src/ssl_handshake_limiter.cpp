@@ -0,0 +1,107 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/ssl_handshake_limiter.h"
+#include <utility>
+#include <vector>
+#include "src/server_counters.h"
+
+ssl_handshake_limiter::ssl_handshake_limiter(void) : limit_(0), active_(0), max_pending_(0), wait_timeout_(0) {
+}
+
+ssl_handshake_limiter::~ssl_handshake_limiter(void) {
+}
+
+void ssl_handshake_limiter::set_limit(std::size_t limit, std::size_t max_pending, clock_type::duration wait_timeout) {
+    lock_type lock(mutex_);
+    limit_ = limit;
+    max_pending_ = max_pending;
+    wait_timeout_ = wait_timeout;
+}
+
+void ssl_handshake_limiter::acquire(start_handle_type start_handle) {
+    {
+        lock_type lock(mutex_);
+        if (limit_ && active_ >= limit_ && max_pending_ && pending_.size() >= max_pending_) {
+            lock.unlock();
+            server_counters_get_instance()->add(server_counters::ssl_handshakes_refused);
+            return start_handle(nullptr);
+        }
+        if (limit_ && active_ >= limit_) {
+            pending_.push_back(pending_handshake{ std::move(start_handle), clock_type::now() });
+            server_counters_get_instance()->add(server_counters::ssl_handshakes_queued);
+            server_counters_get_instance()->set(server_counters::ssl_handshakes_waiting, pending_.size());
+            return;
+        }
+        ++active_;
+    }
+    start_handle(make_permit());
+}
+
+void ssl_handshake_limiter::start(io_context_type& ioc) {
+    timer_.reset(new boost::asio::steady_timer(ioc));
+    wait();
+}
+
+void ssl_handshake_limiter::clear(void) {
+    timer_.reset();
+    std::deque<pending_handshake> pending;
+    {
+        lock_type lock(mutex_);
+        pending.swap(pending_);
+        server_counters_get_instance()->set(server_counters::ssl_handshakes_waiting, 0);
+    }
+}
+
+ssl_handshake_limiter::permit_type ssl_handshake_limiter::make_permit(void) {
+    return permit_type(static_cast<void*>(this), [](void* limiter) { static_cast<this_type*>(limiter)->release(); });
+}
+
+void ssl_handshake_limiter::release(void) {
+    pending_handshake next;
+    {
+        lock_type lock(mutex_);
+        if (pending_.empty()) {
+            --active_;
+            return;
+        }
+        // The permit is handed over to the oldest waiting handshake
+        next = std::move(pending_.front());
+        pending_.pop_front();
+        server_counters_get_instance()->set(server_counters::ssl_handshakes_waiting, pending_.size());
+    }
+    server_counters_get_instance()->add(server_counters::ssl_handshake_wait_nanoseconds,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - next.queued_time).count());
+    next.start_handle(make_permit());
+}
+
+void ssl_handshake_limiter::wait(void) {
+    enum { tick_milliseconds = 100 };
+    timer_->expires_after(std::chrono::milliseconds(tick_milliseconds));
+    timer_->async_wait([this](boost::system::error_code ec) { on_tick(ec); });
+}
+
+void ssl_handshake_limiter::on_tick(boost::system::error_code ec) {
+    if (ec == boost::asio::error::operation_aborted)
+        return;
+
+    // The queue is in arrival order: the expired handshakes are at its front
+    std::vector<pending_handshake> expired;
+    {
+        lock_type lock(mutex_);
+        const auto now = clock_type::now();
+        while (wait_timeout_.count() && !pending_.empty() && now - pending_.front().queued_time >= wait_timeout_) {
+            expired.emplace_back(std::move(pending_.front()));
+            pending_.pop_front();
+        }
+        if (!expired.empty())
+            server_counters_get_instance()->set(server_counters::ssl_handshakes_waiting, pending_.size());
+    }
+    wait();
+
+    if (!expired.empty())
+        server_counters_get_instance()->add(server_counters::ssl_handshakes_refused, expired.size());
+    for (auto& handshake : expired)
+        handshake.start_handle(nullptr);
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Bounds the TLS handshakes running at once. A handshake starts with a permit, the next waiting one is started
+// when the permit is released (the handshake is done or its session is destroyed):
+//
+//      acquire(start) --> start(permit) at once, or queued until a permit is released
+//
+// The queue is bounded in length and in time: a handshake over the cap, or which waited too long, is started with
+// a null permit and its connection is closed.
+//
+
+#ifndef SRC_SSL_HANDSHAKE_LIMITER_H_
+#define SRC_SSL_HANDSHAKE_LIMITER_H_
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+class ssl_handshake_limiter {
+ public:
+    typedef ssl_handshake_limiter                                           this_type;
+    typedef std::mutex                                                      mutex_type;
+    typedef std::unique_lock<mutex_type>                                    lock_type;
+    typedef std::chrono::steady_clock                                       clock_type;
+    typedef std::shared_ptr<void>                                           permit_type;
+    typedef boost::asio::io_context                                         io_context_type;
+    // It may be called on the thread which releases a permit: the handshake should be posted to its executor.
+    // A null permit means the handshake is refused.
+    typedef std::function<void(permit_type)>                                start_handle_type;
+
+    struct pending_handshake {
+        start_handle_type           start_handle;
+        clock_type::time_point      queued_time;
+    };
+
+ public:
+    ssl_handshake_limiter(void);
+    ~ssl_handshake_limiter(void);
+    explicit ssl_handshake_limiter(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+ public:
+    // 0 means unlimited: the handshakes at once, the waiting ones and their wait
+    void set_limit(std::size_t limit, std::size_t max_pending, clock_type::duration wait_timeout);
+    void acquire(start_handle_type start_handle);
+    // The waits are checked on ioc
+    void start(io_context_type& ioc);
+    // Drop the waiting handshakes, it must be called before their io_context is destroyed
+    void clear(void);
+
+ private:
+    permit_type make_permit(void);
+    void release(void);
+    void wait(void);
+    void on_tick(boost::system::error_code ec);
+
+ private:
+    mutex_type                          mutex_;
+    std::size_t                         limit_;
+    std::size_t                         active_;
+    std::size_t                         max_pending_;
+    clock_type::duration                wait_timeout_;
+    std::deque<pending_handshake>       pending_;
+    std::unique_ptr<boost::asio::steady_timer>  timer_;
+};
+
+ssl_handshake_limiter* ssl_handshake_limiter_get_instance(void);
+
+#endif  // SRC_SSL_HANDSHAKE_LIMITER_H_
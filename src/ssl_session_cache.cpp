@@ -0,0 +1,192 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/ssl_session_cache.h"
+#include <cstring>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+#include "base/utils.h"
+#include "src/server_counters.h"
+#include "src/server_options.h"
+
+namespace {
+
+// The handshake time of a connection, accumulated while OpenSSL runs the state machine
+struct handshake_timing {
+    std::chrono::steady_clock::time_point       call_start;
+    bool                                        in_call;
+    bool                                        done;
+    uint64_t                                    nanoseconds;
+};
+
+void free_handshake_timing(void* /*parent*/, void* ptr, CRYPTO_EX_DATA* /*ad*/, int /*idx*/, long /*argl*/, void* /*argp*/) {  // NOLINT(runtime/int)
+    delete static_cast<handshake_timing*>(ptr);
+}
+
+int handshake_timing_index(void) {
+    static const int k_index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, free_handshake_timing);
+    return k_index;
+}
+
+void handle_ssl_info(const SSL* ssl, int where, int /*ret*/) {
+    const int index = handshake_timing_index();
+    auto timing = static_cast<handshake_timing*>(SSL_get_ex_data(ssl, index));
+    if (!timing) {
+        timing = new handshake_timing{ std::chrono::steady_clock::time_point(), false, false, 0 };
+        SSL_set_ex_data(const_cast<SSL*>(ssl), index, timing);
+    }
+    if (timing->done)
+        return;
+
+    const auto now = std::chrono::steady_clock::now();
+    if ((where & SSL_CB_LOOP) && !timing->in_call) {
+        timing->call_start = now;
+        timing->in_call = true;
+    } else if ((where & (SSL_CB_EXIT | SSL_CB_HANDSHAKE_DONE)) && timing->in_call) {
+        timing->nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(now - timing->call_start).count();
+        timing->in_call = false;
+    }
+
+    if (where & SSL_CB_HANDSHAKE_DONE) {
+        timing->done = true;
+        auto counters = server_counters_get_instance();
+        if (SSL_session_reused(const_cast<SSL*>(ssl))) {
+            counters->add(server_counters::ssl_handshakes_resumed);
+            counters->add(server_counters::ssl_handshake_resumed_nanoseconds, timing->nanoseconds);
+        } else {
+            counters->add(server_counters::ssl_handshakes_full);
+            counters->add(server_counters::ssl_handshake_full_nanoseconds, timing->nanoseconds);
+        }
+    }
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+typedef EVP_MAC_CTX     ticket_hmac_context_type;
+bool init_ticket_hmac(ticket_hmac_context_type* hmac_context, unsigned char* hmac_key) {
+    char digest[] = "sha256";
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, hmac_key, ssl_ticket_keys::hmac_key_size),
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+        OSSL_PARAM_construct_end()
+    };
+    return EVP_MAC_CTX_set_params(hmac_context, params) == 1;
+}
+#else
+typedef HMAC_CTX        ticket_hmac_context_type;
+bool init_ticket_hmac(ticket_hmac_context_type* hmac_context, unsigned char* hmac_key) {
+    return HMAC_Init_ex(hmac_context, hmac_key, ssl_ticket_keys::hmac_key_size, EVP_sha256(), nullptr) == 1;
+}
+#endif
+
+int handle_ticket_key(SSL* /*ssl*/, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cipher_context,
+                      ticket_hmac_context_type* hmac_context, int encrypt) {
+    ssl_ticket_keys::ticket_key key;
+    if (encrypt) {
+        if (!ssl_ticket_keys_get_instance()->current(&key) || RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1)
+            return -1;
+        std::memcpy(key_name, key.name, ssl_ticket_keys::name_size);
+        if (EVP_EncryptInit_ex(cipher_context, EVP_aes_256_cbc(), nullptr, key.aes_key, iv) != 1 || !init_ticket_hmac(hmac_context, key.hmac_key))
+            return -1;
+        return 1;
+    }
+
+    // An unknown key (expired or from another server) falls back to a full handshake
+    const int found = ssl_ticket_keys_get_instance()->find(key_name, &key);
+    if (!found)
+        return 0;
+    if (!init_ticket_hmac(hmac_context, key.hmac_key) || EVP_DecryptInit_ex(cipher_context, EVP_aes_256_cbc(), nullptr, key.aes_key, iv) != 1)
+        return -1;
+    return found;
+}
+
+}  // namespace
+
+ssl_ticket_keys::ssl_ticket_keys(void) {
+}
+
+ssl_ticket_keys::~ssl_ticket_keys(void) {
+    for (auto& key : keys_)
+        OPENSSL_cleanse(&key, sizeof(key));
+}
+
+bool ssl_ticket_keys::current(ticket_key* key) {
+    lock_type lock(mutex_);
+    if (!rotate_if_needed())
+        return false;
+    *key = keys_.front();
+    return true;
+}
+
+int ssl_ticket_keys::find(const unsigned char* name, ticket_key* key) {
+    lock_type lock(mutex_);
+    rotate_if_needed();
+    for (std::size_t i = 0; i < keys_.size(); ++i) {
+        if (!std::memcmp(keys_[i].name, name, name_size)) {
+            *key = keys_[i];
+            return i ? 2 : 1;
+        }
+    }
+    return 0;
+}
+
+// The caller must hold the lock.
+bool ssl_ticket_keys::rotate_if_needed(void) {
+    const auto now = clock_type::now();
+    const auto rotation_interval = std::chrono::seconds(server_options_get_instance()->ssl_ticket_key_rotation);
+    if (!keys_.empty() && (rotation_interval.count() == 0 || now - rotated_time_ < rotation_interval))
+        return true;
+
+    ticket_key key;
+    if (RAND_bytes(reinterpret_cast<unsigned char*>(&key), sizeof(key)) != 1) {
+        LOG(ERROR) << "ssl_ticket_keys.rotate: RAND_bytes failed.";
+        return !keys_.empty();
+    }
+    keys_.push_front(key);
+    while (keys_.size() > max_key_count) {
+        OPENSSL_cleanse(&keys_.back(), sizeof(ticket_key));
+        keys_.pop_back();
+    }
+    rotated_time_ = now;
+    server_counters_get_instance()->add(server_counters::ssl_ticket_key_rotations);
+    return true;
+}
+
+void configure_ssl_session_resumption(boost::asio::ssl::context* ctx) {
+    static const unsigned char k_session_id_context[] = "beast_utils";
+    const auto options = server_options_get_instance();
+    SSL_CTX* native_context = ctx->native_handle();
+
+    SSL_CTX_set_info_callback(native_context, handle_ssl_info);
+    SSL_CTX_set_session_id_context(native_context, k_session_id_context, sizeof(k_session_id_context) - 1);
+    if (options->ssl_session_cache_size) {
+        SSL_CTX_set_session_cache_mode(native_context, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(native_context, options->ssl_session_cache_size);
+        SSL_CTX_set_timeout(native_context, options->ssl_session_timeout);
+    } else {
+        SSL_CTX_set_session_cache_mode(native_context, SSL_SESS_CACHE_OFF);
+    }
+
+    if (options->ssl_session_tickets) {
+        SSL_CTX_clear_options(native_context, SSL_OP_NO_TICKET);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(native_context, handle_ticket_key);
+#else
+        SSL_CTX_set_tlsext_ticket_key_cb(native_context, handle_ticket_key);
+#endif
+    } else {
+        SSL_CTX_set_options(native_context, SSL_OP_NO_TICKET);
+    }
+}
+
+void keep_ssl_session_resumable(SSL* ssl) {
+    // A fatal alert has already removed the session from the cache
+    if (ssl && SSL_is_init_finished(ssl))
+        SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+}
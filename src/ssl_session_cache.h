@@ -0,0 +1,66 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// TLS session resumption: a server-side session cache shared by all the io threads, and stateless session
+// tickets whose keys are rotated by the native layer. A ticket stays valid while its key is kept:
+//
+//      | current key (encrypts and decrypts) | previous keys (decrypt, the ticket is renewed) |
+//
+// The handshakes are timed inside OpenSSL only (the round trips are not counted), so that the CPU saved
+// by the resumed handshakes can be reported.
+//
+
+#ifndef SRC_SSL_SESSION_CACHE_H_
+#define SRC_SSL_SESSION_CACHE_H_
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <boost/asio/ssl/context.hpp>
+
+class ssl_ticket_keys {
+ public:
+    typedef ssl_ticket_keys                                                 this_type;
+    typedef std::mutex                                                      mutex_type;
+    typedef std::unique_lock<mutex_type>                                    lock_type;
+    typedef std::chrono::steady_clock                                       clock_type;
+    enum { name_size = 16, hmac_key_size = 32, aes_key_size = 32, max_key_count = 3 };
+
+    struct ticket_key {
+        unsigned char           name[name_size];
+        unsigned char           hmac_key[hmac_key_size];
+        unsigned char           aes_key[aes_key_size];
+    };
+
+ public:
+    ssl_ticket_keys(void);
+    ~ssl_ticket_keys(void);
+    explicit ssl_ticket_keys(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+ public:
+    // Copy the current key, it is rotated first if it is older than the rotation interval
+    bool current(ticket_key* key);
+    // Returns 0 if the key is unknown, 1 for the current key, 2 for a previous key
+    int find(const unsigned char* name, ticket_key* key);
+
+ private:
+    bool rotate_if_needed(void);
+
+ private:
+    mutex_type                      mutex_;
+    std::deque<ticket_key>          keys_;
+    clock_type::time_point          rotated_time_;
+};
+
+ssl_ticket_keys* ssl_ticket_keys_get_instance(void);
+
+void configure_ssl_session_resumption(boost::asio::ssl::context* ctx);
+
+// OpenSSL drops the cached session of a connection freed without close_notify, which is how most clients leave.
+// It is called before the stream is destroyed: the session of a completed handshake stays resumable.
+void keep_ssl_session_resumable(SSL* ssl);
+
+#endif  // SRC_SSL_SESSION_CACHE_H_
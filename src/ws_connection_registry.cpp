@@ -0,0 +1,210 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/ws_connection_registry.h"
+#include <utility>
+
+ws_connection_registry::ws_connection_registry(void) : count_(0), next_shard_(0) {
+}
+
+ws_connection_registry::~ws_connection_registry(void) {
+}
+
+ws_connection_registry::handle_type ws_connection_registry::add(connection_type connection, void* session, const session_ops* ops) {
+    const std::size_t shard_index = next_shard_.fetch_add(1, std::memory_order_relaxed) & (shard_count - 1);
+    auto& target_shard = shards_[shard_index];
+    lock_type lock(target_shard.mutex);
+
+    uint32_t slot_index = 0;
+    if (!target_shard.free_slots.empty()) {
+        slot_index = target_shard.free_slots.back();
+        target_shard.free_slots.pop_back();
+    } else if (target_shard.slots.size() < max_slot_count) {
+        slot_index = static_cast<uint32_t>(target_shard.slots.size());
+        target_shard.slots.push_back(slot{ 0, false, weak_connection_type(), nullptr, nullptr, attributes_type(), topics_type() });
+    } else {
+        return 0;
+    }
+
+    // Generation 0 is never used, so a valid handle is never 0
+    auto& target_slot = target_shard.slots[slot_index];
+    const handle_type max_generation = (~handle_type(0)) >> (shard_bits + index_bits);
+    target_slot.generation = (target_slot.generation >= max_generation) ? 1 : target_slot.generation + 1;
+    target_slot.used = true;
+    target_slot.connection = connection;
+    target_slot.session = session;
+    target_slot.ops = ops;
+    count_.fetch_add(1, std::memory_order_relaxed);
+    return (target_slot.generation << (shard_bits + index_bits)) | (handle_type(slot_index) << shard_bits) | shard_index;
+}
+
+void ws_connection_registry::remove(handle_type handle) {
+    auto& target_shard = shards_[shard_of(handle)];
+    attributes_type attributes;
+    topics_type topics;
+    {
+        lock_type lock(target_shard.mutex);
+        auto target_slot = find_slot(target_shard, handle);
+        if (!target_slot)
+            return;
+        target_slot->used = false;
+        target_slot->connection.reset();
+        target_slot->session = nullptr;
+        target_slot->ops = nullptr;
+        attributes.swap(target_slot->attributes);
+        topics.swap(target_slot->topics);
+        target_shard.free_slots.push_back(static_cast<uint32_t>(index_of(handle)));
+    }
+    count_.fetch_sub(1, std::memory_order_relaxed);
+
+    for (const auto& topic : topics)
+        remove_subscriber(handle, topic);
+}
+
+ws_connection_registry::connection_type ws_connection_registry::find(handle_type handle) {
+    auto& target_shard = shards_[shard_of(handle)];
+    lock_type lock(target_shard.mutex);
+    auto target_slot = find_slot(target_shard, handle);
+    return target_slot ? target_slot->connection.lock() : connection_type();
+}
+
+ws_connection_registry::session_ref ws_connection_registry::find_session(handle_type handle) {
+    auto& target_shard = shards_[shard_of(handle)];
+    lock_type lock(target_shard.mutex);
+    auto target_slot = find_slot(target_shard, handle);
+    auto connection = target_slot ? target_slot->connection.lock() : connection_type();
+    if (!connection)
+        return session_ref{ connection_type(), nullptr, nullptr };
+    return session_ref{ std::move(connection), target_slot->session, target_slot->ops };
+}
+
+bool ws_connection_registry::exists(handle_type handle) {
+    auto& target_shard = shards_[shard_of(handle)];
+    lock_type lock(target_shard.mutex);
+    return find_slot(target_shard, handle) != nullptr;
+}
+
+bool ws_connection_registry::set_attribute(handle_type handle, const std::string& key, const std::string& value) {
+    auto& target_shard = shards_[shard_of(handle)];
+    lock_type lock(target_shard.mutex);
+    auto target_slot = find_slot(target_shard, handle);
+    if (!target_slot)
+        return false;
+    if (value.empty())
+        target_slot->attributes.erase(key);
+    else
+        target_slot->attributes[key] = value;
+    return true;
+}
+
+bool ws_connection_registry::get_attribute(handle_type handle, const std::string& key, std::string* value) {
+    auto& target_shard = shards_[shard_of(handle)];
+    lock_type lock(target_shard.mutex);
+    auto target_slot = find_slot(target_shard, handle);
+    if (!target_slot)
+        return false;
+    auto it = target_slot->attributes.find(key);
+    if (it == target_slot->attributes.end())
+        return false;
+    if (value)
+        *value = it->second;
+    return true;
+}
+
+void ws_connection_registry::visit(visit_handle_type visit_handle) {
+    std::vector<handle_type> handles;
+    handles.reserve(count());
+    for (std::size_t shard_index = 0; shard_index < shards_.size(); ++shard_index) {
+        auto& target_shard = shards_[shard_index];
+        lock_type lock(target_shard.mutex);
+        for (std::size_t slot_index = 0; slot_index < target_shard.slots.size(); ++slot_index) {
+            const auto& target_slot = target_shard.slots[slot_index];
+            if (target_slot.used)
+                handles.push_back((target_slot.generation << (shard_bits + index_bits)) | (handle_type(slot_index) << shard_bits) | shard_index);
+        }
+    }
+
+    for (auto handle : handles)
+        if (visit_handle(handle))
+            break;
+}
+
+bool ws_connection_registry::subscribe(handle_type handle, const std::string& topic) {
+    if (topic.empty())
+        return false;
+    {
+        auto& target_shard = shards_[shard_of(handle)];
+        lock_type lock(target_shard.mutex);
+        auto target_slot = find_slot(target_shard, handle);
+        if (!target_slot)
+            return false;
+        target_slot->topics.insert(topic);
+    }
+    {
+        auto& target_shard = topic_shard_of(topic);
+        lock_type lock(target_shard.mutex);
+        target_shard.subscribers[topic].insert(handle);
+    }
+
+    // The connection may have been removed meanwhile: don't leave it behind in the topic
+    if (!exists(handle)) {
+        remove_subscriber(handle, topic);
+        return false;
+    }
+    return true;
+}
+
+bool ws_connection_registry::unsubscribe(handle_type handle, const std::string& topic) {
+    {
+        auto& target_shard = shards_[shard_of(handle)];
+        lock_type lock(target_shard.mutex);
+        auto target_slot = find_slot(target_shard, handle);
+        if (!target_slot || !target_slot->topics.erase(topic))
+            return false;
+    }
+    remove_subscriber(handle, topic);
+    return true;
+}
+
+void ws_connection_registry::collect(const std::string& topic, handle_type exclude_handle, handles_type* handles) {
+    if (topic.empty()) {
+        handles->reserve(count());
+        visit([exclude_handle, handles](handle_type handle) {
+            if (handle != exclude_handle)
+                handles->push_back(handle);
+            return false;
+        });
+        return;
+    }
+
+    auto& target_shard = topic_shard_of(topic);
+    lock_type lock(target_shard.mutex);
+    auto it = target_shard.subscribers.find(topic);
+    if (it == target_shard.subscribers.end())
+        return;
+    handles->reserve(it->second.size());
+    for (auto handle : it->second)
+        if (handle != exclude_handle)
+            handles->push_back(handle);
+}
+
+void ws_connection_registry::remove_subscriber(handle_type handle, const std::string& topic) {
+    auto& target_shard = topic_shard_of(topic);
+    lock_type lock(target_shard.mutex);
+    auto it = target_shard.subscribers.find(topic);
+    if (it == target_shard.subscribers.end())
+        return;
+    it->second.erase(handle);
+    if (it->second.empty())
+        target_shard.subscribers.erase(it);
+}
+
+// The caller must hold the lock of the shard.
+ws_connection_registry::slot* ws_connection_registry::find_slot(shard& target_shard, handle_type handle) {
+    const std::size_t slot_index = index_of(handle);
+    if (slot_index >= target_shard.slots.size())
+        return nullptr;
+    auto& target_slot = target_shard.slots[slot_index];
+    return (target_slot.used && target_slot.generation == generation_of(handle)) ? &target_slot : nullptr;
+}
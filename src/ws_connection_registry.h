@@ -0,0 +1,152 @@
+// Copyright (c) 2022 The csew Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// The registry of the opened WebSocket connections.
+//
+// A connection handle packs the slot it lives in and the generation of that slot:
+//
+//      | generation (remaining bits) | slot index (20 bits) | shard (4 bits) |
+//
+// A slot is reused with a new generation once its connection is closed, so a stale handle never
+// resolves to another connection, and the lookup of a closed connection simply fails.
+//
+// A connection is registered with the operations of its session type, so that it's used without a cast:
+//
+//      add(sp_session)                         --> the operations of the static type of the session
+//      find_session(handle).send(payload)      --> a call through the table of that type
+//
+// Connections may subscribe to topics. The subscribers are sharded by the topic name, a connection
+// remembers its topics so that they are cleaned up when it is removed.
+//
+
+#ifndef SRC_WS_CONNECTION_REGISTRY_H_
+#define SRC_WS_CONNECTION_REGISTRY_H_
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "base/memory_utils_base.hpp"
+
+class ws_connection_registry {
+ public:
+    typedef ws_connection_registry                                          this_type;
+    typedef uintptr_t                                                       handle_type;
+    typedef std::shared_ptr<virtual_enable_shared_from_this_base>           connection_type;
+    typedef std::weak_ptr<virtual_enable_shared_from_this_base>             weak_connection_type;
+    typedef std::unordered_map<std::string, std::string>                    attributes_type;
+    typedef std::unordered_set<std::string>                                 topics_type;
+    typedef std::vector<handle_type>                                        handles_type;
+    typedef std::function<bool(handle_type)>                                visit_handle_type;
+    typedef std::mutex                                                      mutex_type;
+    typedef std::unique_lock<mutex_type>                                    lock_type;
+    typedef std::shared_ptr<const std::string>                              payload_type;
+    enum { shard_bits = 4, index_bits = 20, shard_count = 1 << shard_bits, max_slot_count = 1 << index_bits };
+
+    // The operations of a session type, the session is passed as it was registered
+    struct session_ops {
+        void (*send)(void* session, payload_type payload, const std::string& key, bool binary);
+        std::size_t (*queued_bytes)(void* session);
+        std::size_t (*memory_bytes)(void* session);
+    };
+
+    // A registered session, the connection keeps it alive
+    struct session_ref {
+        connection_type             connection;
+        void*                       session;
+        const session_ops*          ops;
+
+        explicit operator bool(void) const { return connection != nullptr; }
+        void send(payload_type payload, const std::string& key, bool binary) const { ops->send(session, std::move(payload), key, binary); }
+        std::size_t queued_bytes(void) const { return ops->queued_bytes(session); }
+        std::size_t memory_bytes(void) const { return ops->memory_bytes(session); }
+    };
+
+    struct slot {
+        handle_type                 generation;
+        bool                        used;
+        weak_connection_type        connection;
+        void*                       session;
+        const session_ops*          ops;
+        attributes_type             attributes;
+        topics_type                 topics;
+    };
+
+    struct shard {
+        mutex_type                  mutex;
+        std::vector<slot>           slots;
+        std::vector<uint32_t>       free_slots;
+    };
+
+    struct topic_shard {
+        mutex_type                                                      mutex;
+        std::unordered_map<std::string, std::unordered_set<handle_type>> subscribers;
+    };
+
+ public:
+    ws_connection_registry(void);
+    ~ws_connection_registry(void);
+    explicit ws_connection_registry(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+ public:
+    // Returns 0 if the registry is full
+    template<class Session>
+    handle_type add(const std::shared_ptr<Session>& session) { return add(session, session.get(), &ops_of<Session>()); }
+    handle_type add(connection_type connection, void* session, const session_ops* ops);
+    void remove(handle_type handle);
+    connection_type find(handle_type handle);
+    // An empty reference if the connection is closed
+    session_ref find_session(handle_type handle);
+    bool exists(handle_type handle);
+    std::size_t count(void) const { return count_.load(std::memory_order_relaxed); }
+
+    // Set an empty value to remove the attribute
+    bool set_attribute(handle_type handle, const std::string& key, const std::string& value);
+    bool get_attribute(handle_type handle, const std::string& key, std::string* value);
+
+    // The handles are collected first, so the visitor may call back into the registry. Return true to stop.
+    void visit(visit_handle_type visit_handle);
+
+    bool subscribe(handle_type handle, const std::string& topic);
+    bool unsubscribe(handle_type handle, const std::string& topic);
+    // An empty topic collects all the connections
+    void collect(const std::string& topic, handle_type exclude_handle, handles_type* handles);
+
+ private:
+    template<class Session>
+    static const session_ops& ops_of(void) {
+        static const session_ops ops = {
+            [](void* session, payload_type payload, const std::string& key, bool binary) {
+                static_cast<Session*>(session)->send(std::move(payload), key, binary);
+            },
+            [](void* session) { return static_cast<Session*>(session)->queued_bytes(); },
+            [](void* session) { return static_cast<Session*>(session)->memory_bytes(); },
+        };
+        return ops;
+    }
+    static std::size_t shard_of(handle_type handle) { return handle & (shard_count - 1); }
+    static std::size_t index_of(handle_type handle) { return (handle >> shard_bits) & (max_slot_count - 1); }
+    static handle_type generation_of(handle_type handle) { return handle >> (shard_bits + index_bits); }
+    slot* find_slot(shard& target_shard, handle_type handle);
+    topic_shard& topic_shard_of(const std::string& topic) { return topic_shards_[std::hash<std::string>()(topic) & (shard_count - 1)]; }
+    void remove_subscriber(handle_type handle, const std::string& topic);
+
+ private:
+    std::array<shard, shard_count>          shards_;
+    std::array<topic_shard, shard_count>    topic_shards_;
+    std::atomic<std::size_t>                count_;
+    std::atomic<std::size_t>                next_shard_;
+};
+
+ws_connection_registry* ws_connection_registry_get_instance(void);
+
+#endif  // SRC_WS_CONNECTION_REGISTRY_H_